@@ -1,16 +1,46 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <charconv>
+#include <cmath>
+#include <condition_variable>
 #include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <exception>
 #include <fstream>
 #include <iostream>
 #include <map>
-#include <sstream>
+#include <set>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <string>
 #include <string_view>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
+#if !defined(BSTT_JSON_NO_SIMD) && (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define BSTT_JSON_X86_SIMD
+#include <immintrin.h>
+#endif
+
+#if !defined(BSTT_JSON_NO_MMAP) && (defined(__unix__) || defined(__APPLE__))
+#define BSTT_JSON_POSIX_FILE
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 #define FROM_TO_JSON(Type)                                                                                                       \
 	template <> inline Type fromJson<Type>(const Json& json) { return static_cast<Type>(json); }                                 \
 	template <> inline Json toJson<Type>(const Type& i) { return Json{i}; }
@@ -23,6 +53,11 @@
 	template <> inline Type fromJson<Type>(const Json& json) { return static_cast<Type>(static_cast<CastType>(json)); }          \
 	template <> inline Json toJson<Type>(const Type& i) { return Json{static_cast<CastType>(i)}; }
 
+// Type needs a JsonFields specialization, missing keys keep the default values of the members
+#define FROM_TO_JSON_FIELDS(Type)                                                                                                \
+	template <> inline Type fromJson<Type>(const Json& json) { return detail::FieldsConverter<Type>::fromJson(json); }           \
+	template <> inline Json toJson<Type>(const Type& value) { return detail::FieldsConverter<Type>::toJson(value); }
+
 #ifdef USE_BSTT_NAMESPACE
 namespace bstt
 {
@@ -31,29 +66,305 @@ namespace bstt
 
 	static constexpr size_t MAX_JSON_DEPTH = 1024;
 
+	// objects with at least this many keys get a hash index (when the keys are not sorted)
+	static constexpr size_t JSON_OBJECT_INDEX_THRESHOLD = 16;
+
+	// indentations of the writers, cached by each thread so concurrent writers do not share them
 	static const std::string& getTab(const std::string& tab, size_t tabCount)
 	{
-		static std::map<std::string, std::vector<std::string>> tabListMap;
-		static std::string emptyTab;
+		static thread_local std::map<std::string, std::deque<std::string>> tabListMap; // deque: references stay valid
+		static const std::string emptyTab;
 		if (tab.empty()) return emptyTab;
 		auto it = tabListMap.find(tab);
-		if (it == tabListMap.end())
-		{
-			tabListMap.emplace(tab, std::vector<std::string>{"", tab});
-			it = tabListMap.find(tab);
-			it->second.reserve(MAX_JSON_DEPTH);
-		}
+		if (it == tabListMap.end()) it = tabListMap.emplace(tab, std::deque<std::string>{"", tab}).first;
 		while (it->second.size() <= tabCount) it->second.push_back(it->second.back() + tab);
 		return it->second[tabCount];
 	}
 
+	// Bump allocator for parsed documents: allocations only move a pointer forward inside the current chunk,
+	// deallocations are no-ops and release() frees the whole document chunk by chunk.
+	class JsonArena
+	{
+	public:
+		explicit JsonArena(size_t chunkSize = 64 * 1024) : chunkSize(chunkSize) {}
+		JsonArena(const JsonArena&) = delete;
+		JsonArena& operator=(const JsonArena&) = delete;
+		~JsonArena() { release(); }
+
+		void* allocate(size_t size, size_t alignment)
+		{
+			usedSize += size;
+			if (static_cast<size_t>(end - current) < size + alignment)
+			{
+				// big blocks get a chunk of their own, so the current chunk keeps being filled
+				if (head != nullptr && size > chunkSize / 4) return align(pushChunk(size + alignment, false), alignment);
+				current = pushChunk(std::max(chunkSize, size + alignment), true);
+			}
+			char* aligned = align(current, alignment);
+			current = aligned + size;
+			return aligned;
+		}
+
+		void release()
+		{
+			while (head != nullptr)
+			{
+				Chunk* next = head->next;
+				::operator delete(head);
+				head = next;
+			}
+			current = end = nullptr;
+			chunkCount = 0;
+			usedSize = 0;
+		}
+
+		// frees the chunks but the current one, which is reused from its start
+		void reset()
+		{
+			if (head == nullptr) return;
+			while (head->next != nullptr)
+			{
+				Chunk* next = head->next->next;
+				::operator delete(head->next);
+				head->next = next;
+			}
+			current = reinterpret_cast<char*>(head + 1);
+			chunkCount = 1;
+			usedSize = 0;
+		}
+
+		size_t getChunkCount() const { return chunkCount; }
+		size_t getUsedSize() const { return usedSize; }
+
+	private:
+		struct Chunk
+		{
+			Chunk* next;
+		};
+
+		Chunk* head = nullptr;
+		char* current = nullptr;
+		char* end = nullptr;
+		size_t chunkSize;
+		size_t chunkCount = 0;
+		size_t usedSize = 0;
+
+		static char* align(char* p, size_t alignment)
+		{
+			return reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(p) + alignment - 1) & ~(alignment - 1));
+		}
+
+		char* pushChunk(size_t size, bool makeCurrent)
+		{
+			auto* chunk = static_cast<Chunk*>(::operator new(sizeof(Chunk) + size));
+			char* data = reinterpret_cast<char*>(chunk + 1);
+			++chunkCount;
+			if (makeCurrent)
+			{
+				chunk->next = head;
+				head = chunk;
+				end = data + size;
+			}
+			else
+			{
+				chunk->next = head->next;
+				head->next = chunk;
+			}
+			return data;
+		}
+	};
+
+	// Allocator of the Json containers: uses the arena when it has one, the global heap otherwise.
+	// Copies always go back to the heap, so a Json copied out of a document does not depend on its arena.
+	template <typename T> struct JsonAllocator
+	{
+		using value_type = T;
+		using propagate_on_container_copy_assignment = std::false_type;
+		using propagate_on_container_move_assignment = std::false_type;
+		using propagate_on_container_swap = std::false_type;
+
+		JsonArena* arena = nullptr;
+
+		JsonAllocator() noexcept = default;
+		explicit JsonAllocator(JsonArena* arena) noexcept : arena(arena) {}
+		template <typename U> JsonAllocator(const JsonAllocator<U>& other) noexcept : arena(other.arena) {}
+
+		T* allocate(size_t n)
+		{
+			if (arena != nullptr) return static_cast<T*>(arena->allocate(n * sizeof(T), alignof(T)));
+			return std::allocator<T>().allocate(n);
+		}
+		void deallocate(T* p, size_t n) noexcept
+		{
+			if (arena == nullptr) std::allocator<T>().deallocate(p, n);
+		}
+
+		JsonAllocator select_on_container_copy_construction() const { return JsonAllocator(); }
+
+		template <typename U> bool operator==(const JsonAllocator<U>& other) const { return arena == other.arena; }
+		template <typename U> bool operator!=(const JsonAllocator<U>& other) const { return arena != other.arena; }
+	};
+
+	// Key of the Json objects: an owned std::string, or a handle to the text of a JsonKeyPool.
+	// Keys read like a const std::string, handles of the same pool are compared without reading the text.
+	class JsonKey
+	{
+	public:
+		JsonKey() = default;
+		JsonKey(const char* key) : text(key) {}
+		JsonKey(const std::string& key) : text(key) {}
+		JsonKey(std::string&& key) noexcept : text(std::move(key)) {}
+		explicit JsonKey(const std::string_view& key) : text(key) {}
+
+		const std::string& str() const { return pooled != nullptr ? pooled->text : text; }
+		operator const std::string&() const { return str(); }
+		operator std::string_view() const { return str(); }
+		const char* c_str() const { return str().c_str(); }
+		const char* data() const { return str().data(); }
+		size_t size() const { return str().size(); }
+		size_t length() const { return str().size(); }
+		bool empty() const { return str().empty(); }
+
+		bool isPooled() const { return pooled != nullptr; }
+		// pooled keys compute their hash once
+		size_t hash() const { return pooled != nullptr ? pooled->hash : std::hash<std::string_view>()(text); }
+
+		// a pool stores each text once, so equal handles mean equal texts
+		friend bool operator==(const JsonKey& a, const JsonKey& b)
+		{
+			if (a.pooled != nullptr && a.pooled == b.pooled) return true;
+			return a.str() == b.str();
+		}
+		friend bool operator!=(const JsonKey& a, const JsonKey& b) { return !(a == b); }
+		friend bool operator<(const JsonKey& a, const JsonKey& b) { return a.str() < b.str(); }
+
+		// comparisons with the other strings (std::string, std::string_view, const char*)
+		template <typename T> using IfText = std::enable_if_t<std::is_convertible_v<const T&, std::string_view>, bool>;
+		template <typename T> friend IfText<T> operator==(const JsonKey& a, const T& b) { return a.str() == std::string_view(b); }
+		template <typename T> friend IfText<T> operator==(const T& a, const JsonKey& b) { return std::string_view(a) == b.str(); }
+		template <typename T> friend IfText<T> operator!=(const JsonKey& a, const T& b) { return !(a == b); }
+		template <typename T> friend IfText<T> operator!=(const T& a, const JsonKey& b) { return !(a == b); }
+		template <typename T> friend IfText<T> operator<(const JsonKey& a, const T& b) { return a.str() < std::string_view(b); }
+		template <typename T> friend IfText<T> operator<(const T& a, const JsonKey& b) { return std::string_view(a) < b.str(); }
+
+		// concatenations give a std::string
+		friend std::string operator+(const JsonKey& a, const JsonKey& b) { return a.str() + b.str(); }
+		template <typename T>
+		using IfTextString = std::enable_if_t<std::is_convertible_v<const T&, std::string_view>, std::string>;
+		template <typename T> friend IfTextString<T> operator+(const JsonKey& a, const T& b)
+		{
+			return std::string(a.str()).append(std::string_view(b));
+		}
+		template <typename T> friend IfTextString<T> operator+(const T& a, const JsonKey& b)
+		{
+			return std::string(std::string_view(a)).append(b.str());
+		}
+
+		friend std::ostream& operator<<(std::ostream& os, const JsonKey& key) { return os << key.str(); }
+
+	private:
+		friend class JsonKeyPool;
+
+		struct Entry
+		{
+			std::string text;
+			size_t hash;
+		};
+
+		std::string text;
+		const Entry* pooled = nullptr;
+	};
+
+	// Thread-safe pool of object keys, shared by the parses of many documents (see JsonParseOptions::keyPool).
+	// Each distinct key is stored once: the parsed objects only keep a handle to it, so the pool must outlive them.
+	// Lookups of known keys take no lock, only the first use of a key does.
+	class JsonKeyPool
+	{
+	public:
+		JsonKeyPool() { tables.push_back(std::make_unique<Table>(64)); table.store(tables.back().get()); }
+		JsonKeyPool(const JsonKeyPool&) = delete;
+		JsonKeyPool& operator=(const JsonKeyPool&) = delete;
+
+		// the handle of the key, added on first use
+		JsonKey intern(const std::string_view& key)
+		{
+			size_t hash = std::hash<std::string_view>()(key);
+			JsonKey handle;
+			handle.pooled = find(*table.load(std::memory_order_acquire), key, hash);
+			if (handle.pooled != nullptr) return handle;
+
+			std::lock_guard<std::mutex> lock(mutex);
+			Table* current = table.load(std::memory_order_relaxed);
+			handle.pooled = find(*current, key, hash); // another thread may have added it meanwhile
+			if (handle.pooled != nullptr) return handle;
+			if ((entries.size() + 1) * 2 > current->size) current = grow(*current);
+			entries.push_back(JsonKey::Entry{std::string(key), hash});
+			handle.pooled = &entries.back();
+			place(*current, handle.pooled);
+			return handle;
+		}
+
+		size_t size() const
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			return entries.size();
+		}
+
+	private:
+		// Insert-only open addressing table: a slot is published once its entry is complete, so readers need no lock.
+		// Replaced tables are kept until the pool is destroyed, readers may still be probing them.
+		struct Table
+		{
+			size_t size;
+			std::unique_ptr<std::atomic<const JsonKey::Entry*>[]> slots;
+
+			explicit Table(size_t size) : size(size), slots(new std::atomic<const JsonKey::Entry*>[size])
+			{
+				for (size_t i = 0; i < size; ++i) slots[i].store(nullptr, std::memory_order_relaxed);
+			}
+		};
+
+		mutable std::mutex mutex; // serializes the insertions
+		std::deque<JsonKey::Entry> entries;
+		std::vector<std::unique_ptr<Table>> tables;
+		std::atomic<Table*> table{nullptr};
+
+		static const JsonKey::Entry* find(const Table& t, const std::string_view& key, size_t hash)
+		{
+			size_t mask = t.size - 1;
+			for (size_t slot = hash & mask;; slot = (slot + 1) & mask)
+			{
+				const JsonKey::Entry* entry = t.slots[slot].load(std::memory_order_acquire);
+				if (entry == nullptr) return nullptr;
+				if (entry->hash == hash && entry->text == key) return entry;
+			}
+		}
+
+		static void place(Table& t, const JsonKey::Entry* entry)
+		{
+			size_t mask = t.size - 1;
+			size_t slot = entry->hash & mask;
+			while (t.slots[slot].load(std::memory_order_relaxed) != nullptr) slot = (slot + 1) & mask;
+			t.slots[slot].store(entry, std::memory_order_release);
+		}
+
+		Table* grow(const Table& current)
+		{
+			tables.push_back(std::make_unique<Table>(current.size * 2));
+			Table* bigger = tables.back().get();
+			for (const auto& entry : entries) place(*bigger, &entry);
+			table.store(bigger, std::memory_order_release);
+			return bigger;
+		}
+	};
+
 #ifdef SORT_JSON_OBJECT_KEYS
-	using JsonObj = std::map<std::string, struct Json>;
+	using JsonObj = std::map<JsonKey, struct Json, std::less<>, JsonAllocator<std::pair<const JsonKey, struct Json>>>;
 #else
-using JsonObj = std::vector<std::pair<std::string, struct Json>>;
+using JsonObj = std::vector<std::pair<JsonKey, struct Json>, JsonAllocator<std::pair<JsonKey, struct Json>>>;
 #endif
 
-	using JsonArr = std::vector<struct Json>;
+	using JsonArr = std::vector<struct Json, JsonAllocator<struct Json>>;
 
 	template <typename T> T from_string(const std::string& s);
 
@@ -70,58 +381,201 @@ using JsonObj = std::vector<std::pair<std::string, struct Json>>;
 
 	template <typename T> Json toJson(const T&);
 
-	void parseValue(const std::string_view& str, size_t& pos, Json& jsonValue, size_t depth);
+	// Field map of a struct, used by Json::parseInto to read the text straight into its members, and by FROM_TO_JSON_FIELDS:
+	//	template <> struct JsonFields<Person>
+	//	{
+	//		static constexpr auto fields = std::make_tuple(jsonField("name", &Person::name), jsonField("age", &Person::age));
+	//	};
+	template <typename T> struct JsonFields
+	{
+	};
 
-	struct Json
+	template <typename Class, typename Member> struct JsonField
 	{
-		enum class Type : uint8_t
-		{
-			Null,
-			Bool,
-			Number,
-			String,
-			Array,
-			Object
-		};
+		std::string_view name;
+		Member Class::*member;
+	};
 
-		static std::string typeToString(Type type)
+	template <typename Class, typename Member>
+	constexpr JsonField<Class, Member> jsonField(std::string_view name, Member Class::*member)
+	{
+		return {name, member};
+	}
+
+	struct JsonParseOptions
+	{
+		// arrays and objects are allocated in the arena, which must outlive the result
+		JsonArena* arena = nullptr;
+		// string values point into the parsed text, which must outlive the result (keys are always copied)
+		bool borrowStrings = false;
+		// keys are handles to the pool instead of copies, the pool must outlive the result
+		JsonKeyPool* keyPool = nullptr;
+		// nesting limit of the parser, which does not recurse: copying, writing and destroying the result do, so only
+		// raise it for documents whose depth fits on the stack
+		size_t maxDepth = MAX_JSON_DEPTH;
+	};
+
+	// Parallel parsing of JSON Lines (see Json::parseLines) and of a top level array (see Json::parseElements)
+	struct JsonParallelOptions
+	{
+		// 0 for std::thread::hardware_concurrency()
+		size_t threadCount = 0;
+		// true: the callbacks are called by the calling thread, in the order of the lines
+		// false: they are called by the parsing threads, concurrently, as soon as each line is parsed
+		bool ordered = true;
+		// bytes of text parsed at once by a thread, cut at a line end or between two elements
+		size_t batchSize = 1 << 20;
+	};
+
+	enum class JsonErrorCode : uint8_t
+	{
+		None,
+		ExpectedCharacter, // see JsonError::expected
+		ExpectedHexDigit,
+		InvalidEscape,
+		InvalidStringCharacter,
+		InvalidNumber,
+		ExtraComma,
+		ExtraCharacters,
+		MaxDepthExceeded,
+		UnexpectedType // Json::parseInto: valid json, but not of the type read
+	};
+
+	// Parse error, filled without allocating: the message is only built by toString
+	struct JsonError
+	{
+		JsonErrorCode code = JsonErrorCode::None;
+		char expected = '\0'; // the missing character of ExpectedCharacter
+		size_t offset = 0;	  // in bytes from the start of the text
+		size_t line = 0;	  // from 1, 0 when unknown (push parsing)
+		size_t column = 0;	  // from 1, in bytes
+		size_t maxDepth = MAX_JSON_DEPTH; // the limit of MaxDepthExceeded
+
+		explicit operator bool() const { return code != JsonErrorCode::None; }
+
+		std::string toString() const
 		{
-			static const std::vector<std::string> typeStringArr = {"Null", "Bool", "Number", "String", "Array", "Object"};
-			return typeStringArr[static_cast<size_t>(type)];
+			std::string position = " at position " + std::to_string(offset);
+			switch (code)
+			{
+			case JsonErrorCode::None:
+				return "";
+			case JsonErrorCode::ExpectedCharacter:
+				return "Expected '" + std::string(1, expected) + "'" + position;
+			case JsonErrorCode::ExpectedHexDigit:
+				return "Expected hex digit" + position;
+			case JsonErrorCode::InvalidEscape:
+				return "Invalid escape character" + position;
+			case JsonErrorCode::InvalidStringCharacter:
+				return "Invalid character in string" + position;
+			case JsonErrorCode::InvalidNumber:
+				return "Invalid number" + position;
+			case JsonErrorCode::ExtraComma:
+				return "Extra comma" + position;
+			case JsonErrorCode::ExtraCharacters:
+				return "Extra characters" + position;
+			case JsonErrorCode::MaxDepthExceeded:
+				return "Exceeded maximum depth of " + std::to_string(maxDepth);
+			case JsonErrorCode::UnexpectedType:
+				return "Unexpected type" + position;
+			}
+			return "";
 		}
+	};
 
-		template <typename T> static Json::Type typeToType(const T&) { return Type::Null; }
-		static Type typeToType(const bool&) { return Type::Bool; }
-		static Type typeToType(const int&) { return Type::Number; }
-		static Type typeToType(const int64_t&) { return Type::Number; }
-		static Type typeToType(const size_t&) { return Type::Number; }
-		static Type typeToType(const double&) { return Type::Number; }
-		static Type typeToType(const std::string&) { return Type::String; }
-		static Type typeToType(const JsonObj&) { return Type::Object; }
-		static Type typeToType(const JsonArr&) { return Type::Array; }
+	// Thrown by Json::parse and the other throwing parse functions
+	class JsonParseError : public std::runtime_error
+	{
+	public:
+		explicit JsonParseError(const JsonError& error) : std::runtime_error(error.toString()), error(error) {}
+
+		const JsonError& getError() const { return error; }
+
+	private:
+		JsonError error;
+	};
 
-		static Json parse(const std::string_view& str)
+	// Read-only content of a whole file: memory-mapped on POSIX systems (read() when the file cannot be mapped, like a pipe),
+	// read into a buffer elsewhere or with BSTT_JSON_NO_MMAP. The view is valid until the file is closed.
+	class JsonFile
+	{
+	public:
+		JsonFile() = default;
+		explicit JsonFile(const std::string& fileName) { open(fileName); }
+		JsonFile(JsonFile&& other) noexcept { *this = std::move(other); }
+		JsonFile& operator=(JsonFile&& other) noexcept
 		{
-			Json json;
-			size_t pos = 0;
-			parseValue(str, pos, json, 0);
-			if (pos != str.size()) throw std::runtime_error("Extra characters at position " + std::to_string(pos));
-			return json;
+			if (this == &other) return *this;
+			close();
+			data = std::exchange(other.data, nullptr);
+			size = std::exchange(other.size, 0);
+			mapped = std::exchange(other.mapped, false);
+			buffer = std::move(other.buffer);
+			if (!mapped) data = buffer.data();
+			other.buffer.clear();
+			return *this;
 		}
+		JsonFile(const JsonFile&) = delete;
+		JsonFile& operator=(const JsonFile&) = delete;
+		~JsonFile() { close(); }
 
-		static bool tryParse(const std::string_view& str, Json& json)
+		void open(const std::string& fileName)
 		{
-			std::string error;
-			return tryParse(str, json, error);
+			close();
+#ifdef BSTT_JSON_POSIX_FILE
+			int fd = ::open(fileName.c_str(), O_RDONLY);
+			if (fd < 0) throw std::runtime_error("Cannot open file " + fileName);
+			struct stat st;
+			bool regular = ::fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0;
+			if (regular)
+			{
+				void* address = ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+				if (address != MAP_FAILED)
+				{
+					::madvise(address, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+					::close(fd);
+					data = static_cast<const char*>(address);
+					size = static_cast<size_t>(st.st_size);
+					mapped = true;
+					return;
+				}
+			}
+			if (regular) buffer.reserve(static_cast<size_t>(st.st_size));
+			char chunk[65536];
+			for (;;)
+			{
+				ssize_t count = ::read(fd, chunk, sizeof(chunk));
+				if (count == 0) break;
+				if (count < 0)
+				{
+					if (errno == EINTR) continue;
+					::close(fd);
+					buffer.clear();
+					throw std::runtime_error("Cannot read file " + fileName);
+				}
+				buffer.append(chunk, static_cast<size_t>(count));
+			}
+			::close(fd);
+#else
+			std::ifstream ifs(fileName, std::ios::binary | std::ios::ate);
+			if (!ifs) throw std::runtime_error("Cannot open file " + fileName);
+			buffer.resize(static_cast<size_t>(ifs.tellg()));
+			ifs.seekg(0);
+			if (!ifs.read(buffer.data(), static_cast<std::streamsize>(buffer.size())))
+			{
+				buffer.clear();
+				throw std::runtime_error("Cannot read file " + fileName);
+			}
+#endif
+			data = buffer.data();
+			size = buffer.size();
 		}
 
-		static bool tryParse(const std::string_view& str, Json& json, std::string& error)
+		bool tryOpen(const std::string& fileName, std::string& error)
 		{
-			size_t pos = 0;
 			try
 			{
-				parseValue(str, pos, json, 0);
-				if (pos != str.size()) throw std::runtime_error("Extra characters at position " + std::to_string(pos));
+				open(fileName);
 				return true;
 			}
 			catch (const std::exception& e)
@@ -131,299 +585,745 @@ using JsonObj = std::vector<std::pair<std::string, struct Json>>;
 			}
 		}
 
-		static Json parseFile(const std::string& fileName)
-		{
-			std::ifstream ifs(fileName);
-			std::ostringstream oss;
-			oss << ifs.rdbuf();
-			return parse(oss.str());
-		}
-
-		static bool tryParseFile(const std::string& fileName, Json& json)
-		{
-			std::string error;
-			return tryParseFile(fileName, json, error);
-		}
-
-		static bool tryParseFile(const std::string& fileName, Json& json, std::string& error)
+		void close()
 		{
-			std::ifstream ifs(fileName);
-			std::ostringstream oss;
-			oss << ifs.rdbuf();
-			return tryParse(oss.str(), json, error);
+#ifdef BSTT_JSON_POSIX_FILE
+			if (mapped) ::munmap(const_cast<char*>(data), size);
+#endif
+			data = nullptr;
+			size = 0;
+			mapped = false;
+			buffer = std::string();
 		}
 
-		// Constructors
+		std::string_view getView() const { return {data, size}; }
+		bool isMapped() const { return mapped; }
 
-		Json() : b(false) {} // default is null
-		Json(const Json& v) { *this = v; }
-		template <typename T> Json(const T& v) { *this = v; }
+	private:
+		const char* data = nullptr;
+		size_t size = 0;
+		bool mapped = false;
+		std::string buffer; // content when the file is not mapped
+	};
 
-		// Move constructor
+	// Sink of Json::write buffering the output of a stream, the tokens reach the stream by blocks
+	class JsonStreamSink
+	{
+	public:
+		explicit JsonStreamSink(std::ostream& os) : os(os) {}
+		JsonStreamSink(const JsonStreamSink&) = delete;
+		JsonStreamSink& operator=(const JsonStreamSink&) = delete;
+		~JsonStreamSink() { flush(); }
 
-		Json(Json&& v) noexcept : type(v.type), b(false)
+		void append(const char* data, size_t size)
 		{
-			switch (v.type)
+			if (used + size > sizeof(buffer))
 			{
-			case Type::Null:
-				break;
-			case Type::Bool:
-				b = v.b;
-				break;
-			case Type::Number:
-				num = v.num;
-				break;
-			case Type::String:
-				new (&str) std::string(std::move(v.str));
-				break;
-			case Type::Object:
-				new (&obj) JsonObj(std::move(v.obj));
-				break;
-			case Type::Array:
-				new (&arr) JsonArr(std::move(v.arr));
-				break;
+				flush();
+				if (size > sizeof(buffer))
+				{
+					os.write(data, static_cast<std::streamsize>(size));
+					return;
+				}
 			}
-			v.type = Type::Null;
+			std::copy(data, data + size, buffer + used);
+			used += size;
 		}
 
-		// Destructor
+		void flush()
+		{
+			if (used > 0) os.write(buffer, static_cast<std::streamsize>(used));
+			used = 0;
+		}
 
-		~Json() {}
+	private:
+		std::ostream& os;
+		char buffer[8192];
+		size_t used = 0;
+	};
 
-		// Assignments
+	namespace detail
+	{
+		// integers are kept exactly when they fit 64 bits
+		enum class NumberKind : uint8_t
+		{
+			Double,
+			Int64,
+			UInt64 // only above INT64_MAX
+		};
 
-		Json& operator=(const Json& rhs)
+		// largest text of formatNumber: -2.2250738585072014e-308
+		static constexpr size_t MAX_NUMBER_SIZE = 24;
+
+		// shortest text parsed back to the same double, integers are written with all their digits
+		inline size_t formatNumber(double num, char (&buffer)[32])
 		{
-			if (this == &rhs) return *this;
-			type = rhs.type;
-			switch (rhs.type)
+			// up to 2^53 every integer is exact, -0 keeps its sign
+			if (num > -9007199254740992.0 && num < 9007199254740992.0 && num == static_cast<double>(static_cast<int64_t>(num))
+				&& (num != 0 || !std::signbit(num)))
 			{
-			case Type::Null:
-				b = false;
-				break;
-			case Type::Bool:
-				b = rhs.b;
-				break;
-			case Type::Number:
-				num = rhs.num;
-				break;
-			case Type::String:
-				*this = rhs.str;
-				break;
-			case Type::Object:
-				*this = rhs.obj;
-				break;
-			case Type::Array:
-				*this = rhs.arr;
-				break;
+				auto end = std::to_chars(buffer, buffer + sizeof(buffer), static_cast<int64_t>(num)).ptr;
+				return static_cast<size_t>(end - buffer);
 			}
-			return *this;
-		}
-		Json& operator=(std::nullptr_t)
-		{
-			type = Type::Null;
-			return *this;
-		}
-		Json& operator=(bool b_)
+#ifdef __cpp_lib_to_chars
+			return static_cast<size_t>(std::to_chars(buffer, buffer + sizeof(buffer), num).ptr - buffer);
+#else
+		int size = 0;
+		for (int precision = 15; precision <= 17; ++precision)
 		{
-			type = Type::Bool;
-			b = b_;
-			return *this;
+			size = std::snprintf(buffer, sizeof(buffer), "%.*g", precision, num);
+			if (std::strtod(buffer, nullptr) == num) break;
 		}
-		Json& operator=(int i)
-		{
-			type = Type::Number;
-			num = i;
-			return *this;
+		return static_cast<size_t>(size);
+#endif
 		}
-		Json& operator=(int64_t i)
+
+		// Sink of Json::toString: copies the tokens after the end of the string, grown by the expected size at once.
+		// The expected size is an upper bound, a string left with more than twice its size is shrunk.
+		class StringSink
 		{
-			type = Type::Number;
-			num = static_cast<double>(i);
-			return *this;
+		public:
+			StringSink(std::string& out, size_t expectedSize) : out(out), used(out.size())
+			{
+				out.resize(used + expectedSize);
+				data = &out[0];
+			}
+			StringSink(const StringSink&) = delete;
+			StringSink& operator=(const StringSink&) = delete;
+			~StringSink()
+			{
+				out.resize(used);
+				if (out.capacity() > 2 * used) out.shrink_to_fit();
+			}
+
+			void append(const char* text, size_t size)
+			{
+				if (used + size > out.size())
+				{
+					out.resize(std::max(out.size() * 2, used + size));
+					data = &out[0];
+				}
+				std::memcpy(data + used, text, size);
+				used += size;
+			}
+
+		private:
+			std::string& out;
+			char* data;
+			size_t used;
+		};
+	} // namespace detail
+
+	// Base of the handlers given to Json::parseEvents: hide the events you need, the others are ignored.
+	// Strings and keys are given as written in json (escape sequences are not decoded), they point into the parsed text.
+	// Integers that fit 64 bits go to onInteger(int64_t) and onUnsigned(uint64_t) (above INT64_MAX) when the handler
+	// defines them, to onNumber otherwise.
+	struct JsonHandler
+	{
+		void onNull() {}
+		void onBool(bool) {}
+		void onNumber(double) {}
+		void onString(const std::string_view&) {}
+		void onStartObject() {}
+		void onKey(const std::string_view&) {}
+		void onEndObject() {}
+		void onStartArray() {}
+		void onEndArray() {}
+	};
+
+	void parseValue(
+		const std::string_view& str, size_t& pos, Json& jsonValue, size_t depth, const JsonParseOptions& options = {});
+	bool parseValue(const std::string_view& str, size_t& pos, Json& jsonValue, size_t depth, const JsonParseOptions& options,
+		JsonError& error);
+
+	namespace detail
+	{
+		template <typename Handler>
+		bool parseValue(const std::string_view& str, size_t& pos, Handler& handler, size_t depth, JsonError& error,
+			size_t maxDepth = MAX_JSON_DEPTH);
+
+		// fills the error, the line and column are only counted here
+		inline bool fail(
+			const std::string_view& str, JsonError& error, JsonErrorCode code, size_t pos, char expected = '\0')
+		{
+			error.code = code;
+			error.expected = expected;
+			error.offset = pos;
+			auto before = str.substr(0, pos);
+			error.line = 1 + static_cast<size_t>(std::count(before.begin(), before.end(), '\n'));
+			size_t lineStart = before.rfind('\n');
+			error.column = lineStart == std::string_view::npos ? pos + 1 : pos - lineStart;
+			return false;
 		}
-		Json& operator=(size_t i)
+
+		class JsonBuilder;
+		template <typename Callback, typename ErrorCallback> class ParallelLineParser;
+		template <typename Callback> class ParallelArrayParser;
+
+		template <typename T, typename = void> struct HasJsonFields : std::false_type
 		{
-			type = Type::Number;
-			num = static_cast<double>(i);
-			return *this;
+		};
+		template <typename T> struct HasJsonFields<T, std::void_t<decltype(JsonFields<T>::fields)>> : std::true_type
+		{
+		};
+
+		template <typename T> struct FieldsConverter;
+
+		template <typename T>
+		bool parseInto(const std::string_view& str, T& value, JsonError& error, const JsonParseOptions& options);
+		template <typename Sink, typename T>
+		void writeTyped(Sink& sink, const T& value, const std::string& tab, const std::string& newLine, size_t tabCount);
+
+		// next line of a JSON Lines text, without its end of line
+		inline std::string_view nextLine(const std::string_view& str, size_t& pos)
+		{
+			size_t end = str.find('\n', pos);
+			if (end == std::string_view::npos) end = str.size();
+			std::string_view line = str.substr(pos, end - pos);
+			pos = end + 1;
+			if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+			return line;
 		}
-		Json& operator=(double d_)
+
+		inline bool isBlankLine(const std::string_view& line) { return line.find_first_not_of(" \t") == std::string_view::npos; }
+	} // namespace detail
+
+	struct Json
+	{
+		enum class Type : uint8_t
 		{
-			type = Type::Number;
-			num = d_;
-			return *this;
+			Null,
+			Bool,
+			Number,
+			String,
+			Array,
+			Object
+		};
+
+		static std::string typeToString(Type type)
+		{
+			static const std::vector<std::string> typeStringArr = {"Null", "Bool", "Number", "String", "Array", "Object"};
+			return typeStringArr[static_cast<size_t>(type)];
+		}
+
+		template <typename T> static Json::Type typeToType(const T&) { return Type::Null; }
+		static Type typeToType(const bool&) { return Type::Bool; }
+		static Type typeToType(const int&) { return Type::Number; }
+		static Type typeToType(const int64_t&) { return Type::Number; }
+		static Type typeToType(const size_t&) { return Type::Number; }
+		static Type typeToType(const double&) { return Type::Number; }
+		static Type typeToType(const std::string&) { return Type::String; }
+		static Type typeToType(const JsonObj&) { return Type::Object; }
+		static Type typeToType(const JsonArr&) { return Type::Array; }
+
+		// The tryParse functions do not throw on invalid json, Json::parse throws a JsonParseError
+
+		static Json parse(const std::string_view& str, const JsonParseOptions& options = {})
+		{
+			Json json;
+			JsonError error;
+			if (!tryParse(str, json, error, options)) throw JsonParseError(error);
+			return json;
 		}
-		Json& operator=(const char* s_)
+
+		static bool tryParse(const std::string_view& str, Json& json, const JsonParseOptions& options = {})
+		{
+			JsonError error;
+			return tryParse(str, json, error, options);
+		}
+
+		static bool tryParse(const std::string_view& str, Json& json, std::string& error, const JsonParseOptions& options = {})
+		{
+			JsonError jsonError;
+			if (tryParse(str, json, jsonError, options)) return true;
+			error = jsonError.toString();
+			return false;
+		}
+
+		static bool tryParse(const std::string_view& str, Json& json, JsonError& error, const JsonParseOptions& options = {})
 		{
-			type = Type::String;
-			new (&str) std::string(s_);
-			// replace tabs and newlines with escape sequences
 			size_t pos = 0;
-			while ((pos = str.find_first_of("\t\r\n", pos)) != std::string::npos)
+			error = JsonError();
+			if (!parseValue(str, pos, json, 0, options, error)) return false;
+			return pos == str.size() || detail::fail(str, error, JsonErrorCode::ExtraCharacters, pos);
+		}
+
+		// Event parsing: the handler receives the values in document order, no Json is built (see JsonHandler)
+
+		template <typename Handler>
+		static void parseEvents(const std::string_view& str, Handler& handler, size_t maxDepth = MAX_JSON_DEPTH)
+		{
+			JsonError error;
+			if (!tryParseEvents(str, handler, error, maxDepth)) throw JsonParseError(error);
+		}
+
+		template <typename Handler>
+		static bool tryParseEvents(
+			const std::string_view& str, Handler& handler, std::string& error, size_t maxDepth = MAX_JSON_DEPTH)
+		{
+			JsonError jsonError;
+			if (tryParseEvents(str, handler, jsonError, maxDepth)) return true;
+			error = jsonError.toString();
+			return false;
+		}
+
+		template <typename Handler>
+		static bool tryParseEvents(
+			const std::string_view& str, Handler& handler, JsonError& error, size_t maxDepth = MAX_JSON_DEPTH)
+		{
+			size_t pos = 0;
+			error = JsonError();
+			if (!detail::parseValue(str, pos, handler, 0, error, maxDepth)) return false;
+			return pos == str.size() || detail::fail(str, error, JsonErrorCode::ExtraCharacters, pos);
+		}
+
+		// JSON Lines parsing: each non-blank line of the text is a document (see JsonLineReader to iterate on them).
+		// The lines are parsed one by one in the same value, whose containers are allocated in an arena reused from line
+		// to line (options.arena is ignored): copy the value to keep it. callback(Json& value, size_t lineNumber) is
+		// called for the valid lines, onError(const JsonError& error) for the others, with the offset and line of the error
+		// in the whole text. An invalid line does not stop the parsing, the number of invalid lines is returned.
+
+		template <typename Callback, typename ErrorCallback>
+		static size_t parseLines(
+			const std::string_view& str, Callback&& callback, ErrorCallback&& onError, JsonParseOptions options = {})
+		{
+			JsonArena arena;
+			options.arena = &arena;
+			Json value;
+			JsonError error;
+			size_t errorCount = 0;
+			for (size_t pos = 0, lineNumber = 1; pos < str.size(); ++lineNumber)
 			{
-				if (str[pos] == '\t') str.replace(pos, 1, "\\t");
-				else if (str[pos] == '\r')
-					str.replace(pos, 1, "\\r");
+				std::string_view line = detail::nextLine(str, pos);
+				if (detail::isBlankLine(line)) continue;
+				value = nullptr; // before the arena holding the previous line is reset
+				arena.reset();
+				if (tryParseLine(str, line, lineNumber, value, options, error)) callback(value, lineNumber);
 				else
-					str.replace(pos, 1, "\\n");
-				pos += 2;
+				{
+					++errorCount;
+					onError(static_cast<const JsonError&>(error));
+				}
+			}
+			return errorCount;
+		}
+
+		// Same with several threads, each batch of lines being parsed in its own arena
+		template <typename Callback, typename ErrorCallback>
+		static size_t parseLines(const std::string_view& str, Callback&& callback, ErrorCallback&& onError,
+			const JsonParallelOptions& parallel, const JsonParseOptions& options = {})
+		{
+			detail::ParallelLineParser<Callback, ErrorCallback> parser(str, callback, onError, parallel, options);
+			return parser.run();
+		}
+
+		// Parallel parsing of a document whose top level is an array: its elements are parsed by several threads, the
+		// result is the one of Json::parse. Other documents, or with one thread, it is Json::parse. The values are
+		// allocated on the heap, options.arena is ignored.
+
+		static Json parse(
+			const std::string_view& str, const JsonParallelOptions& parallel, const JsonParseOptions& options = {});
+		static bool tryParse(const std::string_view& str, Json& json, JsonError& error, const JsonParallelOptions& parallel,
+			const JsonParseOptions& options = {});
+
+		// Same without building the array: callback(Json& element, size_t index) receives its elements, which are
+		// allocated in arenas reused afterwards (copy an element to keep it). Throws a JsonParseError when the text is
+		// not valid or not an array.
+		template <typename Callback>
+		static void parseElements(const std::string_view& str, Callback&& callback, const JsonParallelOptions& parallel = {},
+			const JsonParseOptions& options = {})
+		{
+			detail::ParallelArrayParser<Callback> parser(str, callback, parallel, options, false);
+			JsonError error;
+			if (!parser.cut())
+			{
+				JsonHandler handler;
+				if (tryParseEvents(str, handler, error, options.maxDepth))
+				{
+					size_t pos = str.find_first_not_of(" \t\n\r"); // a valid document is not blank
+					detail::fail(str, error, JsonErrorCode::ExpectedCharacter, pos, '[');
+				}
+				throw JsonParseError(error);
+			}
+			if (!parser.run(error)) throw JsonParseError(error);
+		}
+
+		// Typed parsing: the text is read straight into value, no Json is built. Structs with JsonFields are read member
+		// by member, unknown keys are skipped and missing ones keep the value of their member. bool, numbers,
+		// std::string (as written in json, like Json strings), std::vector, std::optional (null when empty),
+		// std::map with string keys and Json are read directly, other types through a Json and fromJson<T>.
+		// A valid value of another type than the one read is an UnexpectedType error.
+
+		template <typename T> static T parseAs(const std::string_view& str, const JsonParseOptions& options = {})
+		{
+			T value{};
+			parseInto(str, value, options);
+			return value;
+		}
+
+		template <typename T> static void parseInto(const std::string_view& str, T& value, const JsonParseOptions& options = {})
+		{
+			JsonError error;
+			if (!tryParseInto(str, value, error, options)) throw JsonParseError(error);
+		}
+
+		template <typename T>
+		static bool tryParseInto(const std::string_view& str, T& value, JsonError& error, const JsonParseOptions& options = {})
+		{
+			error = JsonError();
+			return detail::parseInto(str, value, error, options);
+		}
+
+		// Arena parsing: arrays and objects of the result are allocated in the arena, which must outlive the result
+
+		static Json parse(const std::string_view& str, JsonArena& arena) { return parse(str, JsonParseOptions{&arena}); }
+
+		static bool tryParse(const std::string_view& str, Json& json, JsonArena& arena)
+		{
+			return tryParse(str, json, JsonParseOptions{&arena});
+		}
+
+		static bool tryParse(const std::string_view& str, Json& json, std::string& error, JsonArena& arena)
+		{
+			return tryParse(str, json, error, JsonParseOptions{&arena});
+		}
+
+		// The file is parsed in place (see JsonFile) and closed on return, so strings are never borrowed here:
+		// use JsonDocument::parseFile to keep them pointing into the file.
+
+		static Json parseFile(const std::string& fileName, JsonParseOptions options = {})
+		{
+			options.borrowStrings = false;
+			JsonFile file(fileName);
+			return parse(file.getView(), options);
+		}
+
+		static bool tryParseFile(const std::string& fileName, Json& json, const JsonParseOptions& options = {})
+		{
+			std::string error;
+			return tryParseFile(fileName, json, error, options);
+		}
+
+		static bool tryParseFile(const std::string& fileName, Json& json, std::string& error, JsonParseOptions options = {})
+		{
+			options.borrowStrings = false;
+			JsonFile file;
+			return file.tryOpen(fileName, error) && tryParse(file.getView(), json, error, options);
+		}
+
+		// Constructors
+
+		Json() : borrowed(false), inlineString(false), arenaPayload(false), inlineSize(0), b(false) {} // default is null
+		Json(const Json& v) : borrowed(false), inlineString(false), arenaPayload(false), inlineSize(0), b(false) { copyFrom(v); }
+		// rvalues are moved in: strings, vectors, maps, JsonObj, JsonArr and Json keep their buffers
+		template <typename T, typename = std::enable_if_t<!std::is_same_v<std::decay_t<T>, Json>>>
+		Json(T&& v) : borrowed(false), inlineString(false), arenaPayload(false), inlineSize(0), b(false)
+		{
+			*this = std::forward<T>(v);
+		}
+
+		// Move constructor
+
+		Json(Json&& v) noexcept : borrowed(false), inlineString(false), arenaPayload(false), inlineSize(0), b(false)
+		{
+			moveFrom(v);
+		}
+
+		// Destructor
+
+		~Json() { destroy(); }
+
+		// Assignments
+
+		Json& operator=(const Json& rhs)
+		{
+			if (this == &rhs) return *this;
+			switch (rhs.type)
+			{
+			case Type::Null:
+				return *this = nullptr;
+			case Type::Bool:
+				return *this = rhs.b;
+			case Type::Number:
+				destroy();
+				copyNumber(rhs);
+				return *this;
+			case Type::String:
+				if (!isStringBox()) break;
+				*strBox = rhs.getStringView(); // reuse the current buffer
+				return *this;
+			case Type::Object:
+			case Type::Array:
+				break;
 			}
+			// copy before destroying the current value, rhs may be one of its children
+			Json copy(rhs);
+			destroy();
+			moveFrom(copy);
 			return *this;
 		}
-		Json& operator=(const std::string& s_) { return *this = s_.c_str(); }
-		Json& operator=(const JsonObj& obj_)
+		Json& operator=(std::nullptr_t)
 		{
-			type = Type::Object;
-			new (&obj) JsonObj(obj_);
+			destroy();
 			return *this;
 		}
-		Json& operator=(const JsonArr& arr_)
+		Json& operator=(bool b_)
 		{
-			type = Type::Array;
-			new (&arr) JsonArr(arr_);
+			destroy();
+			type = Type::Bool;
+			b = b_;
 			return *this;
 		}
-		Json& operator=(const Json::Type& type)
+		Json& operator=(int i) { return *this = static_cast<int64_t>(i); }
+		Json& operator=(int64_t i)
 		{
-			this->type = type;
+			destroy();
+			type = Type::Number;
+			numberKind = detail::NumberKind::Int64;
+			i64 = i;
 			return *this;
 		}
-		template <typename T> Json& operator=(const T& t)
+		Json& operator=(size_t i) { return setUnsigned(i); }
+		Json& operator=(double d_)
 		{
-			*this = toJson<T>(t);
+			destroy();
+			type = Type::Number;
+			numberKind = detail::NumberKind::Double;
+			num = d_;
 			return *this;
 		}
-		template <typename T, typename U> Json& operator=(const std::map<T, U>& tuMap)
+		Json& operator=(const char* s_) { return assignString(s_); }
+		Json& operator=(const std::string& s_) { return assignString(s_); }
+		Json& operator=(const JsonKey& key_) { return assignString(key_.str()); }
+		Json& operator=(std::string&& s_)
 		{
-			using namespace std;
-			type = Type::Object;
-			new (&obj) JsonObj();
-#ifdef SORT_JSON_OBJECT_KEYS
-			for (const auto& [key, value] : tuMap) (*this)[to_string(key)] = value;
-#else
-		for (const auto& [key, value] : tuMap) this->obj.emplace_back(to_string(key), value);
-#endif
+			// move out before destroying the current value, s_ may be its own string
+			std::string moved(std::move(s_));
+			escapeControlCharacters(moved);
+			if (moved.size() <= INLINE_STRING_CAPACITY) setString(moved, nullptr);
+			else if (isStringBox())
+				*strBox = std::move(moved);
+			else
+			{
+				destroy();
+				strBox = newPayload<std::string>(nullptr, std::move(moved));
+				type = Type::String;
+				countAllocation(type, false);
+			}
 			return *this;
 		}
-		template <typename T> Json& operator=(const std::vector<T>& tList)
+		Json& operator=(const JsonObj& obj_) { return *this = JsonObj(obj_); }
+		Json& operator=(const JsonArr& arr_) { return *this = JsonArr(arr_); }
+		Json& operator=(JsonObj&& obj_)
 		{
-			type = Type::Array;
-			new (&arr) JsonArr();
-			arr.resize(tList.size());
-			for (size_t i = 0; i < tList.size(); i++) (*this)[i] = tList[i];
+			// move out before destroying the current value, obj_ may belong to one of its children
+			JsonObj moved(std::move(obj_));
+			destroy();
+			emplaceObject(std::move(moved));
 			return *this;
 		}
-
-		// Move assignment
-
-		Json& operator=(Json&& rhs) noexcept
+		Json& operator=(JsonArr&& arr_)
 		{
-			if (this == &rhs) return *this;
-			type = rhs.type;
-			switch (rhs.type)
+			JsonArr moved(std::move(arr_));
+			destroy();
+			emplaceArray(std::move(moved));
+			return *this;
+		}
+		Json& operator=(const Json::Type& type_)
+		{
+			switch (type_)
 			{
 			case Type::Null:
-				break;
+				return *this = nullptr;
 			case Type::Bool:
-				b = rhs.b;
-				break;
+				return *this = false;
 			case Type::Number:
-				num = rhs.num;
-				break;
+				return *this = 0.0;
 			case Type::String:
-				new (&str) std::string(std::move(rhs.str));
-				break;
+				return *this = "";
 			case Type::Object:
-				new (&obj) JsonObj(std::move(rhs.obj));
-				break;
+				return *this = JsonObj();
 			case Type::Array:
-				new (&arr) JsonArr(std::move(rhs.arr));
-				break;
+				return *this = JsonArr();
 			}
-			rhs.type = Type::Null;
 			return *this;
 		}
+		template <typename T> Json& operator=(const T& t)
+		{
+			*this = toJson<T>(t);
+			return *this;
+		}
+		// containers are converted at once, the elements of rvalue containers are moved
+		template <typename T, typename U> Json& operator=(const std::map<T, U>& tuMap) { return assignObject(tuMap); }
+		template <typename T, typename U> Json& operator=(std::map<T, U>&& tuMap) { return assignObject(std::move(tuMap)); }
+		template <typename T, typename U> Json& operator=(const std::unordered_map<T, U>& tuMap) { return assignObject(tuMap); }
+		template <typename T, typename U> Json& operator=(std::unordered_map<T, U>&& tuMap)
+		{
+			return assignObject(std::move(tuMap));
+		}
+		template <typename T> Json& operator=(const std::vector<T>& tList) { return assignArray(tList); }
+		template <typename T> Json& operator=(std::vector<T>&& tList) { return assignArray(std::move(tList)); }
+		template <typename T> Json& operator=(const std::deque<T>& tList) { return assignArray(tList); }
+		template <typename T> Json& operator=(std::deque<T>&& tList) { return assignArray(std::move(tList)); }
+		template <typename T> Json& operator=(const std::set<T>& tList) { return assignArray(tList); }
+		template <typename T> Json& operator=(std::set<T>&& tList) { return assignArray(std::move(tList)); }
+		template <typename T, size_t N> Json& operator=(const std::array<T, N>& tList) { return assignArray(tList); }
+		template <typename T, size_t N> Json& operator=(std::array<T, N>&& tList) { return assignArray(std::move(tList)); }
+
+		// Move assignment
+
+		Json& operator=(Json&& rhs) noexcept
+		{
+			if (this == &rhs) return *this;
+			// move out before destroying the current value, rhs may be one of its children
+			Json moved(std::move(rhs));
+			destroy();
+			moveFrom(moved);
+			return *this;
+		}
+
+#ifdef BSTT_JSON_COUNT_ALLOCATIONS
+		// Opt-in counters of the string, array and object payloads constructed and destroyed by Json values
+
+		struct AllocationCount
+		{
+			size_t allocated;
+			size_t freed;
+
+			size_t getLiveCount() const { return allocated - freed; }
+		};
+
+		static AllocationCount getAllocationCount(Type type_)
+		{
+			const auto& counters = getAllocationCounters();
+			auto index = static_cast<size_t>(type_);
+			return {counters.allocated[index].load(), counters.freed[index].load()};
+		}
+
+		static void resetAllocationCount()
+		{
+			auto& counters = getAllocationCounters();
+			for (auto& count : counters.allocated) count = 0;
+			for (auto& count : counters.freed) count = 0;
+		}
+#endif
 
 		// Converters
 
 		operator bool() const { return b; }
-		operator int() const { return static_cast<int>(num); }
-		operator int() { return static_cast<int>(num); }
-		operator int64_t() const { return static_cast<int64_t>(num); }
-		operator int64_t() { return static_cast<int64_t>(num); }
-		operator size_t() const { return static_cast<size_t>(num); }
-		operator size_t() { return static_cast<size_t>(num); }
-		operator const double&() const { return num; }
-		operator const std::string&() const { return str; }
-		operator const char*() const { return str.c_str(); }
-		operator const JsonObj&() const { return obj; }
-		operator const JsonArr&() const { return arr; }
+		operator int() const { return getNumber<int>(); }
+		operator int() { return getNumber<int>(); }
+		operator int64_t() const { return getNumber<int64_t>(); }
+		operator int64_t() { return getNumber<int64_t>(); }
+		operator size_t() const { return getNumber<size_t>(); }
+		operator size_t() { return getNumber<size_t>(); }
+		operator double() const { return getNumber<double>(); }
+		operator const std::string&() const
+		{
+			if (inlineString) return getInlineCopy();
+			return borrowed ? getBorrowedCopy() : *strBox;
+		}
+		operator const char*() const { return static_cast<const std::string&>(*this).c_str(); }
+		// reads borrowed strings without copying them
+		operator std::string_view() const { return getStringView(); }
+		operator const JsonObj&() const { return objBox->obj; }
+		operator const JsonArr&() const { return *arrBox; }
 		operator bool&()
 		{
 			if (type != Type::Bool) *this = false;
 			return b;
 		}
+		// an integer becomes a double
 		operator double&()
 		{
 			if (type != Type::Number) *this = 0.0;
+			else if (numberKind != detail::NumberKind::Double)
+				*this = getNumber<double>();
 			return num;
 		}
 		operator std::string&()
 		{
-			if (type != Type::String) *this = "";
-			return str;
+			if (!isStringBox())
+			{
+				// take ownership of the text (borrowed or inline), the value can be modified from now on
+				std::string copy(type == Type::String ? getStringView() : std::string_view());
+				destroy();
+				emplaceString(std::move(copy));
+			}
+			return *strBox;
 		}
 		operator JsonObj&()
 		{
 			if (type != Type::Object) *this = JsonObj{};
-			return obj;
+#ifndef SORT_JSON_OBJECT_KEYS
+			// the keys may be changed through the reference, the index is rebuilt by the next non const lookup
+			objBox->objIndex.reset();
+#endif
+			return objBox->obj;
 		}
 		operator JsonArr&()
 		{
 			if (type != Type::Array) *this = JsonArr{};
-			return arr;
+			return *arrBox;
 		}
 		template <typename T> operator T() const { return fromJson<T>(*this); }
 		template <typename T, typename U> operator std::map<T, U>() const
 		{
 			std::map<T, U> tuMap;
-			for (const auto& [key_, val_] : obj) tuMap[key_] = val_;
+			for (const auto& [key_, val_] : objBox->obj)
+			{
+				T key = key_;
+#ifdef SORT_JSON_OBJECT_KEYS
+				// keys in order go at the end
+				tuMap.emplace_hint(tuMap.end(), std::move(key), convertElement<U>(val_));
+#else
+			tuMap.emplace(std::move(key), convertElement<U>(val_));
+#endif
+			}
 			return tuMap;
 		}
-		template <typename T> operator std::vector<T>() const
+		template <typename T, typename U> operator std::unordered_map<T, U>() const
 		{
-			std::vector<T> tList;
-			for (const auto& value : arr) tList.push_back(fromJson<T>(value));
-			return tList;
-		}
-
-		// Get
-
-		template <typename T> void get(const std::string& key, T& value) const
+			std::unordered_map<T, U> tuMap;
+			tuMap.reserve(objBox->obj.size());
+			for (const auto& [key_, val_] : objBox->obj)
+			{
+				T key = key_;
+				tuMap.emplace(std::move(key), convertElement<U>(val_));
+			}
+			return tuMap;
+		}
+		template <typename T> operator std::vector<T>() const
 		{
-			const auto& child = (*this)[key];
-			child.checkKeyType(key, typeToType(value));
-			value = child;
+			std::vector<T> tList;
+			tList.reserve(arrBox->size());
+			for (const auto& value : *arrBox) tList.push_back(convertElement<T>(value));
+			return tList;
 		}
-		void get(const std::string& key, std::string& value) const
+		template <typename T> operator std::deque<T>() const
 		{
-			const auto& child = (*this)[key];
-			child.checkKeyType(key, Type::String);
-			value = std::string(child.str);
+			std::deque<T> tList;
+			for (const auto& value : *arrBox) tList.push_back(convertElement<T>(value));
+			return tList;
 		}
-		template <typename T, typename U> void get(const std::string& key, std::map<T, U>& value) const
+		template <typename T> operator std::set<T>() const
 		{
-			const auto& child = (*this)[key];
-			child.checkKeyType(key, Type::Object);
-			for (const auto& [key_, val_] : child.obj) value[from_string<T>(key_)] = val_;
+			std::set<T> tSet;
+			for (const auto& value : *arrBox) tSet.insert(tSet.end(), convertElement<T>(value));
+			return tSet;
 		}
-		template <typename T> void get(const std::string& key, std::vector<T>& value) const
+		template <typename T, size_t N> operator std::array<T, N>() const
 		{
-			const auto& child = (*this)[key];
-			child.checkKeyType(key, Type::Array);
-			value = child.operator std::vector<T, std::allocator<T>>();
+			if (arrBox->size() != N)
+				throw std::runtime_error("Expected " + std::to_string(N) + " elements but got " + std::to_string(arrBox->size()));
+			std::array<T, N> tList;
+			for (size_t i = 0; i < N; ++i) tList[i] = convertElement<T>((*arrBox)[i]);
+			return tList;
 		}
+
+		// Get
+
+		template <typename T> void get(const std::string& key, T& value) const { (*this)[key].getAs(key, value); }
 		template <typename T, typename... Args> void get(const std::string& key, T& value, Args&&... args) const
 		{
 			get(key, value);
@@ -432,480 +1332,3192 @@ using JsonObj = std::vector<std::pair<std::string, struct Json>>;
 
 		// Set
 
-		template <typename T> void set(const std::string& key, const T& value) { (*this)[key] = value; }
-		template <typename T, typename... Args> void set(const std::string& key, const T& value, Args&&... args)
+		template <typename T> void set(const std::string& key, T&& value) { (*this)[key] = std::forward<T>(value); }
+		template <typename T, typename... Args> void set(const std::string& key, T&& value, Args&&... args)
 		{
-			set(key, value);
+			set(key, std::forward<T>(value));
 			set(std::forward<Args>(args)...);
 		}
 
 		// Try get
 
 	private:
-		JsonObj::iterator objFind(const std::string& key)
+		// the key is any string, or a JsonKey: handles of the parsed keys are compared first
+		template <typename Key> JsonObj::iterator objFind(const Key& key)
+		{
+#ifdef SORT_JSON_OBJECT_KEYS
+			return objBox->obj.find(key);
+#else
+		// big objects are indexed, keep the index in sync before using it
+		if (objBox->obj.size() >= JSON_OBJECT_INDEX_THRESHOLD
+			&& (!objBox->objIndex || objBox->objIndex->indexedCount != objBox->obj.size()))
+		{
+			if (!objBox->objIndex) objBox->objIndex = std::make_unique<ObjIndex>();
+			objBox->objIndex->rebuild(objBox->obj);
+		}
+		return objBox->obj.begin() + static_cast<long long>(std::as_const(*this).objFindIndex(key));
+#endif
+		}
+
+		template <typename Key> JsonObj::const_iterator objFind(const Key& key) const
+		{
+#ifdef SORT_JSON_OBJECT_KEYS
+			return objBox->obj.find(key);
+#else
+		return objBox->obj.begin() + static_cast<long long>(objFindIndex(key));
+#endif
+		}
+
+#ifndef SORT_JSON_OBJECT_KEYS
+		// position of the key in the object, or its size if it is missing
+		template <typename Key> size_t objFindIndex(const Key& key) const
+		{
+			if (objBox->objIndex && objBox->objIndex->indexedCount == objBox->obj.size())
+				return objBox->objIndex->find(objBox->obj, key);
+			// search most efficient when keys are accessed in order: from findIndex to the end, then from the start
+			// findIndex lives in the payload, so it can be modified in const methods
+			const JsonObj& obj = objBox->obj;
+			size_t start = objBox->findIndex.load(std::memory_order_relaxed);
+			if (start >= obj.size()) start = 0;
+			size_t ind = start;
+			while (ind < obj.size() && !(obj[ind].first == key)) ++ind;
+			if (ind == obj.size())
+			{
+				ind = 0;
+				while (ind < start && !(obj[ind].first == key)) ++ind;
+				if (ind == start) return obj.size();
+			}
+			setFindIndex(ind + 1);
+			return ind;
+		}
+
+		// not stored when unchanged, so readers repeating a lookup do not write to the shared payload
+		void setFindIndex(size_t index) const
+		{
+			if (objBox->findIndex.load(std::memory_order_relaxed) != index)
+				objBox->findIndex.store(index, std::memory_order_relaxed);
+		}
+#endif
+
+	public:
+		bool hasKey(const std::string& key) const { return objHasKey(key); }
+		bool hasKey(const char* key) const { return objHasKey(key); }
+		bool hasKey(const JsonKey& key) const { return objHasKey(key); }
+
+	private:
+		template <typename Key> bool objHasKey(const Key& key) const
+		{
+			auto it = objFind(key);
+			if (it != objBox->obj.end())
+			{
+#ifndef SORT_JSON_OBJECT_KEYS
+				// point findIndex at the key since next search will probably be the same key
+				setFindIndex(static_cast<size_t>(it - objBox->obj.begin()));
+#endif
+				return true;
+			}
+			return false;
+		}
+
+	public:
+		template <typename T> bool tryGet(const std::string& key, T& value) const
+		{
+			auto it = objFind(key);
+			if (it != objBox->obj.end()) value = it->second;
+			return it != objBox->obj.end();
+		}
+		bool tryGet(const std::string& key, std::string& value) const
+		{
+			auto it = objFind(key);
+			if (it != objBox->obj.end())
+			{
+				it->second.checkKeyType(key, Type::String);
+				value = it->second.getStringView();
+			}
+			return it != objBox->obj.end();
+		}
+		template <typename T, typename U> bool tryGet(const std::string& key, std::map<T, U>& value) const
+		{
+			auto it = objFind(key);
+			if (it != objBox->obj.end()) it->second.getAs(key, value);
+			return it != objBox->obj.end();
+		}
+		template <typename T, typename U> bool tryGet(const std::string& key, std::unordered_map<T, U>& value) const
+		{
+			auto it = objFind(key);
+			if (it != objBox->obj.end()) it->second.getAs(key, value);
+			return it != objBox->obj.end();
+		}
+		template <typename T> bool tryGet(const std::string& key, std::vector<T>& value) const
+		{
+			auto it = objFind(key);
+			if (it != objBox->obj.end())
+			{
+				it->second.checkKeyType(key, Type::Array);
+				value = std::vector<T>(it->second);
+			}
+			return it != objBox->obj.end();
+		}
+		template <typename T, typename... Args> bool tryGet(const std::string& key, T& value, Args&&... args) const
+		{
+			bool allFound = tryGet(key, value);
+			return tryGet(std::forward(args)...) && allFound;
+		}
+
+		// Array functions
+
+		const Json& back() const { return arrBox->back(); }
+		Json& back() { return arrBox->back(); }
+		const Json& operator[](size_t index) const { return (*arrBox)[index]; }
+		const Json& operator[](int index) const { return (*arrBox)[index]; }
+		// resize the array if needed
+		Json& operator[](size_t index)
+		{
+			if (type != Type::Array) *this = JsonArr();
+			if (arrBox->size() <= index) arrBox->resize(index + 1);
+			return (*arrBox)[index];
+		}
+		Json& operator[](int index) { return (*this)[static_cast<size_t>(index)]; }
+		template <typename... Args> void emplace_back(Args&&... args)
+		{
+			if (type != Type::Array) *this = JsonArr();
+			arrBox->emplace_back(std::forward<Args>(args)...);
+		}
+
+		void resize(size_t size) { arrBox->resize(size); }
+
+		// Object functions
+
+		const Json& operator[](const std::string& key) const { return objAt(key); }
+		const Json& operator[](const std::string_view& key) const { return objAt(key); }
+		const Json& operator[](const char* key) const { return objAt(key); }
+		// handles from a JsonKeyPool find the keys parsed with the same pool without comparing the texts
+		const Json& operator[](const JsonKey& key) const { return objAt(key); }
+
+		Json& operator[](const std::string& key) { return objEmplace(key); }
+		Json& operator[](const std::string_view& key) { return objEmplace(key); }
+		Json& operator[](const char* key) { return objEmplace(key); }
+		Json& operator[](const JsonKey& key) { return objEmplace(key); }
+
+	private:
+		template <typename Key> const Json& objAt(const Key& key) const
+		{
+			auto it = objFind(key);
+			if (it == objBox->obj.end())
+			{
+#ifdef BSTT_JSON_DEBUG
+				std::cerr << "Key not found: '" << key << "'" << std::endl;
+				std::cerr << this->toString() << std::endl;
+#endif
+				throw std::runtime_error("Key not found: '" + std::string(std::string_view(key)) + "'");
+			}
+			return it->second;
+		}
+
+	public:
+
+		// Display
+
+		std::string toString(const std::string& tab = "", const std::string& newLine = "") const
+		{
+			std::string result;
+			{
+				detail::StringSink sink(result, estimateSize(tab.size(), newLine.size()));
+				write(sink, tab, newLine);
+			}
+			return result;
+		}
+
+		friend std::ostream& operator<<(std::ostream& os, const Json& v) { return v.display(os); }
+
+		std::ostream& display(
+			std::ostream& os, const std::string& tab = "", const std::string& newLine = "", size_t currentTabCount = 0) const
+		{
+			JsonStreamSink sink(os);
+			write(sink, tab, newLine, currentTabCount);
+			return os;
+		}
+
+		// Write the text of toString to a sink: any type with append(const char*, size_t), like std::string
+		template <typename Sink>
+		void write(Sink& sink, const std::string& tab = "", const std::string& newLine = "", size_t currentTabCount = 0) const
+		{
+			switch (type)
+			{
+			case Type::Null:
+				sink.append("null", 4);
+				return;
+			case Type::Bool:
+				if (b) sink.append("true", 4);
+				else
+					sink.append("false", 5);
+				return;
+			case Type::Number:
+			{
+				char buffer[32];
+				if (numberKind == detail::NumberKind::Double)
+				{
+					sink.append(buffer, detail::formatNumber(num, buffer));
+					return;
+				}
+				auto end = numberKind == detail::NumberKind::Int64 ? std::to_chars(buffer, buffer + sizeof(buffer), i64).ptr
+																	: std::to_chars(buffer, buffer + sizeof(buffer), u64).ptr;
+				sink.append(buffer, static_cast<size_t>(end - buffer));
+				return;
+			}
+			case Type::String:
+			{
+				auto view = getStringView();
+				sink.append("\"", 1);
+				sink.append(view.data(), view.size());
+				sink.append("\"", 1);
+				return;
+			}
+			case Type::Object:
+				writeAsObject(sink, currentTabCount, tab, newLine);
+				return;
+			case Type::Array:
+				writeAsArray(sink, currentTabCount, tab, newLine);
+				return;
+			}
+		}
+
+		// Size of the text of toString, numbers are counted with their largest size
+		size_t estimateSize(size_t tabSize = 0, size_t newLineSize = 0, size_t currentTabCount = 0) const
+		{
+			switch (type)
+			{
+			case Type::Null:
+			case Type::Bool:
+				return 5;
+			case Type::Number:
+				return detail::MAX_NUMBER_SIZE;
+			case Type::String:
+				return getStringView().size() + 2;
+			case Type::Object:
+			case Type::Array:
+			{
+				size_t count = type == Type::Object ? objBox->obj.size() : arrBox->size();
+				if (count == 0) return 2;
+				// brackets, separators, line breaks and indentation
+				size_t size = 2 + (count - 1) * 2 + (count + 1) * newLineSize
+							  + (count * (currentTabCount + 1) + currentTabCount) * tabSize;
+				if (type == Type::Object)
+					for (const auto& p : objBox->obj)
+						size += p.first.size() + 4 + p.second.estimateSize(tabSize, newLineSize, currentTabCount + 1);
+				else
+					for (const auto& v : *arrBox) size += v.estimateSize(tabSize, newLineSize, currentTabCount + 1);
+				return size;
+			}
+			}
+			return 0;
+		}
+
+		void writeToFile(const std::string& fileName, const std::string& tab = "", const std::string& newLine = "") const
+		{
+			std::ofstream ofs(fileName);
+			JsonStreamSink sink(ofs);
+			write(sink, tab, newLine);
+		}
+
+		// Typed writing: the text of toJson(value).toString(tab, newLine), without building a Json. Structs with
+		// JsonFields are written member by member, the types read directly by Json::parseInto too (an empty
+		// std::optional member is left out, null elsewhere), other types through toJson<T>.
+
+		template <typename T>
+		static std::string valueToString(const T& value, const std::string& tab = "", const std::string& newLine = "")
+		{
+			std::string result;
+			{
+				detail::StringSink sink(result, 256);
+				writeValue(sink, value, tab, newLine);
+			}
+			return result;
+		}
+
+		template <typename Sink, typename T>
+		static void writeValue(Sink& sink, const T& value, const std::string& tab = "", const std::string& newLine = "",
+			size_t currentTabCount = 0)
+		{
+			detail::writeTyped(sink, value, tab, newLine, currentTabCount);
+		}
+
+		// Make this value a string pointing to text it does not own, the text must outlive the value.
+		// Like the parsed strings, the text is kept as written in json (escape sequences are not decoded).
+		Json& borrowString(const std::string_view& text)
+		{
+			setBorrowedString(text, nullptr);
+			return *this;
+		}
+
+		// Getters
+
+		Type getType() const { return type; }
+
+		bool isBorrowedString() const { return type == Type::String && borrowed; }
+
+		size_t size() const
+		{
+			if (type == Type::Array) return arrBox->size();
+			if (type == Type::Object) return objBox->obj.size();
+			return 0;
+		}
+
+		// true for a Number holding an integer: int64_t and size_t values, and parsed integers that fit 64 bits
+		bool isInteger() const { return type == Type::Number && numberKind != detail::NumberKind::Double; }
+
+	private:
+		// the builder puts the parsed strings in the arena of the options
+		friend class detail::JsonBuilder;
+		friend class JsonLineReader;
+		template <typename Callback, typename ErrorCallback> friend class detail::ParallelLineParser;
+		template <typename T> friend struct detail::FieldsConverter;
+
+		// parses a line of str in value, the offset and line of the error are in str
+		static bool tryParseLine(const std::string_view& str, const std::string_view& line, size_t lineNumber, Json& value,
+			const JsonParseOptions& options, JsonError& error)
+		{
+			if (tryParse(line, value, error, options)) return true;
+			value = nullptr;
+			error.offset += static_cast<size_t>(line.data() - str.data());
+			error.line = lineNumber;
+			return false;
+		}
+
+		Type type = Type::Null;
+
+		// representation of a Number
+		detail::NumberKind numberKind = detail::NumberKind::Double;
+
+		// The flags share one byte, so that a short string fits in the rest of the header (cleared by the constructors)
+		// set when a String value points into text it does not own (see JsonParseOptions::borrowStrings)
+		bool borrowed : 1;
+		// set when a String value is short enough to be stored in the node itself, without any allocation
+		bool inlineString : 1;
+		// set when the payload was allocated in the arena of a parsed document: it is destroyed but not deleted
+		bool arenaPayload : 1;
+		uint8_t inlineSize : 3;
+		// the text of an inline string, the payload pointer stays free for its std::string copy (see getInlineCopy)
+		char inlineText[5];
+
+		struct BorrowedString
+		{
+			std::string_view view;
+			mutable std::atomic<std::string*> copy{nullptr};
+
+			explicit BorrowedString(const std::string_view& view) : view(view) {}
+		};
+
+		struct ObjectPayload;
+
+		// scalars are stored inline, strings and containers behind a single pointer
+		union
+		{
+			bool b;
+			double num;
+			int64_t i64;
+			uint64_t u64;
+			std::string* strBox;
+			BorrowedString* borrowedBox;
+			JsonArr* arrBox;
+			ObjectPayload* objBox;
+			mutable std::atomic<std::string*> inlineCopy;
+		};
+
+		static constexpr size_t INLINE_STRING_CAPACITY = sizeof(inlineText);
+
+#ifndef SORT_JSON_OBJECT_KEYS
+		// Open addressing index of the keys, built once the object reaches JSON_OBJECT_INDEX_THRESHOLD keys
+		struct ObjIndex
+		{
+			std::vector<uint32_t> slots; // position + 1 of the key in obj, 0 for an empty slot
+			size_t indexedCount = 0;
+
+			template <typename Key> static size_t hash(const Key& key) { return std::hash<std::string_view>()(key); }
+			static size_t hash(const JsonKey& key) { return key.hash(); }
+
+			template <typename Key> size_t find(const JsonObj& obj, const Key& key) const
+			{
+				size_t mask = slots.size() - 1;
+				for (size_t slot = hash(key) & mask;; slot = (slot + 1) & mask)
+				{
+					uint32_t entry = slots[slot];
+					if (entry == 0) return obj.size();
+					if (obj[entry - 1].first == key) return entry - 1;
+				}
+			}
+
+			// index the last key of obj
+			void push(const JsonObj& obj)
+			{
+				if (obj.size() * 2 > slots.size()) return rebuild(obj);
+				place(obj.size() - 1, obj.back().first);
+				++indexedCount;
+			}
+
+			void rebuild(const JsonObj& obj)
+			{
+				size_t capacity = 2 * JSON_OBJECT_INDEX_THRESHOLD;
+				while (capacity < obj.size() * 4) capacity *= 2;
+				slots.assign(capacity, 0);
+				for (size_t i = 0; i < obj.size(); ++i) place(i, obj[i].first);
+				indexedCount = obj.size();
+			}
+
+			void place(size_t position, const JsonKey& key)
+			{
+				size_t mask = slots.size() - 1;
+				size_t slot = hash(key) & mask;
+				while (slots[slot] != 0) slot = (slot + 1) & mask;
+				slots[slot] = static_cast<uint32_t>(position + 1);
+			}
+		};
+
+#endif
+
+		struct ObjectPayload
 		{
+			JsonObj obj;
+#ifndef SORT_JSON_OBJECT_KEYS
+			// lookup hint, the next search starts there. Written by the const lookups too: concurrent readers may
+			// overwrite each other's hint, which is only a guess
+			std::atomic<size_t> findIndex{0};
+			std::unique_ptr<ObjIndex> objIndex;
+#endif
+
+			explicit ObjectPayload(JsonObj&& obj) : obj(std::move(obj)) {}
+		};
+
+		template <typename Key> Json& objEmplace(const Key& key)
+		{
+			if (type != Type::Object) *this = JsonObj();
+			auto it = objFind(key);
+			if (it != objBox->obj.end()) return it->second;
 #ifdef SORT_JSON_OBJECT_KEYS
-			return obj.find(key);
+			return objBox->obj.emplace_hint(it, JsonKey(key), Json())->second;
 #else
-		// search most efficient when keys are accessed in order
-		for (size_t i = 0; i < obj.size(); ++i)
+		objBox->obj.emplace_back(JsonKey(key), Json());
+		if (objBox->objIndex && objBox->objIndex->indexedCount + 1 == objBox->obj.size()) objBox->objIndex->push(objBox->obj);
+		return objBox->obj.back().second;
+#endif
+		}
+
+		void get() const {}
+		static bool tryGet() { return true; }
+		void set() {}
+
+#ifdef BSTT_JSON_COUNT_ALLOCATIONS
+		struct AllocationCounters
 		{
-			auto ind = (findIndex + i) % obj.size();
-			if (obj[ind].first == key)
+			std::atomic<size_t> allocated[6];
+			std::atomic<size_t> freed[6];
+		};
+
+		static AllocationCounters& getAllocationCounters()
+		{
+			static AllocationCounters counters{};
+			return counters;
+		}
+#endif
+
+		static void countAllocation([[maybe_unused]] Type type_, [[maybe_unused]] bool freed)
+		{
+#ifdef BSTT_JSON_COUNT_ALLOCATIONS
+			auto& counters = getAllocationCounters();
+			(freed ? counters.freed : counters.allocated)[static_cast<size_t>(type_)].fetch_add(1, std::memory_order_relaxed);
+#endif
+		}
+
+		// Payloads go to the arena when there is one, it frees them all at once
+		template <typename T, typename... Args> T* newPayload(JsonArena* arena, Args&&... args)
+		{
+			T* payload = arena != nullptr ? new (arena->allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...)
+										  : new T(std::forward<Args>(args)...);
+			arenaPayload = arena != nullptr;
+			return payload;
+		}
+
+		template <typename T> void deletePayload(T* payload) noexcept
+		{
+			if (arenaPayload) payload->~T();
+			else
+				delete payload;
+			arenaPayload = false;
+		}
+
+		// The emplace functions expect a value without payload (null, bool or number)
+
+		template <typename... Args> void emplaceString(Args&&... args)
+		{
+			strBox = newPayload<std::string>(nullptr, std::forward<Args>(args)...);
+			type = Type::String;
+			countAllocation(type, false);
+		}
+
+		// containers moved in with an arena allocator keep their payload in the same arena
+		template <typename... Args> void emplaceArray(Args&&... args)
+		{
+			JsonArr arr(std::forward<Args>(args)...);
+			arrBox = newPayload<JsonArr>(arr.get_allocator().arena, std::move(arr));
+			type = Type::Array;
+			countAllocation(type, false);
+		}
+
+		template <typename... Args> void emplaceObject(Args&&... args)
+		{
+			JsonObj obj(std::forward<Args>(args)...);
+			objBox = newPayload<ObjectPayload>(obj.get_allocator().arena, std::move(obj));
+			type = Type::Object;
+			countAllocation(type, false);
+#ifndef SORT_JSON_OBJECT_KEYS
+			if (objBox->obj.size() >= JSON_OBJECT_INDEX_THRESHOLD)
+			{
+				objBox->objIndex = std::make_unique<ObjIndex>();
+				objBox->objIndex->rebuild(objBox->obj);
+			}
+#endif
+		}
+
+		// short strings are stored inline, the others go to the arena when there is one (used by the parser)
+		void setString(const std::string_view& text, JsonArena* arena)
+		{
+			destroy();
+			if (text.size() > INLINE_STRING_CAPACITY)
+			{
+				strBox = newPayload<std::string>(arena, text);
+				type = Type::String;
+				countAllocation(type, false);
+				return;
+			}
+			std::memcpy(inlineText, text.data(), text.size());
+			inlineSize = static_cast<uint8_t>(text.size());
+			inlineString = true;
+			new (&inlineCopy) std::atomic<std::string*>(nullptr);
+			type = Type::String;
+		}
+
+		void setBorrowedString(const std::string_view& text, JsonArena* arena)
+		{
+			destroy();
+			borrowedBox = newPayload<BorrowedString>(arena, text);
+			type = Type::String;
+			borrowed = true;
+		}
+
+		// destroy the active member, the value becomes null
+		void destroy(bool counted = true) noexcept
+		{
+			switch (type)
+			{
+			case Type::Null:
+			case Type::Bool:
+			case Type::Number:
+				type = Type::Null;
+				return;
+			case Type::String:
+				if (inlineString)
+				{
+					inlineString = false;
+					std::string* copy = inlineCopy.load(std::memory_order_acquire);
+					if (copy == nullptr)
+					{
+						type = Type::Null;
+						return;
+					}
+					delete copy;
+					break;
+				}
+				if (borrowed)
+				{
+					borrowed = false;
+					std::string* copy = borrowedBox->copy.load(std::memory_order_acquire);
+					deletePayload(borrowedBox);
+					if (copy == nullptr)
+					{
+						type = Type::Null;
+						return;
+					}
+					delete copy;
+					break;
+				}
+				deletePayload(strBox);
+				break;
+			case Type::Array:
+				deletePayload(arrBox);
+				break;
+			case Type::Object:
+				deletePayload(objBox);
+				break;
+			}
+			if (counted) countAllocation(type, true);
+			type = Type::Null;
+		}
+
+		// the value must not have a payload
+		void copyNumber(const Json& v)
+		{
+			numberKind = v.numberKind;
+			switch (numberKind)
+			{
+			case detail::NumberKind::Double:
+				num = v.num;
+				break;
+			case detail::NumberKind::Int64:
+				i64 = v.i64;
+				break;
+			case detail::NumberKind::UInt64:
+				u64 = v.u64;
+				break;
+			}
+			type = Type::Number;
+		}
+
+		// integers are converted without going through double
+		template <typename T> T getNumber() const
+		{
+			if (type != Type::Number) return T();
+			switch (numberKind)
+			{
+			case detail::NumberKind::Int64:
+				return static_cast<T>(i64);
+			case detail::NumberKind::UInt64:
+				return static_cast<T>(u64);
+			case detail::NumberKind::Double:
+				break;
+			}
+			return static_cast<T>(num);
+		}
+
+		// copyFrom and moveFrom also expect a value without payload
+		void copyFrom(const Json& v)
+		{
+			switch (v.type)
+			{
+			case Type::Null:
+				break;
+			case Type::Bool:
+				b = v.b;
+				break;
+			case Type::Number:
+				copyNumber(v);
+				break;
+			case Type::String:
+				setString(v.getStringView(), nullptr);
+				break;
+			case Type::Object:
+				emplaceObject(v.objBox->obj);
+#ifndef SORT_JSON_OBJECT_KEYS
+				if (v.objBox->objIndex) objBox->objIndex = std::make_unique<ObjIndex>(*v.objBox->objIndex);
+#endif
+				break;
+			case Type::Array:
+				emplaceArray(*v.arrBox);
+				break;
+			}
+			type = v.type;
+		}
+
+		// the payload pointer changes owner, nothing is allocated
+		void moveFrom(Json& v) noexcept
+		{
+			switch (v.type)
+			{
+			case Type::Null:
+				break;
+			case Type::Bool:
+				b = v.b;
+				break;
+			case Type::Number:
+				copyNumber(v);
+				break;
+			case Type::String:
+				if (v.inlineString)
+				{
+					std::memcpy(inlineText, v.inlineText, sizeof(inlineText));
+					inlineSize = v.inlineSize;
+					// the copy follows the text, references taken before the move stay valid
+					new (&inlineCopy) std::atomic<std::string*>(v.inlineCopy.load(std::memory_order_acquire));
+				}
+				else if (v.borrowed)
+					borrowedBox = v.borrowedBox;
+				else
+					strBox = v.strBox;
+				break;
+			case Type::Object:
+				objBox = v.objBox;
+				break;
+			case Type::Array:
+				arrBox = v.arrBox;
+				break;
+			}
+			type = v.type;
+			borrowed = v.borrowed;
+			inlineString = v.inlineString;
+			arenaPayload = v.arenaPayload;
+			v.type = Type::Null;
+			v.borrowed = false;
+			v.inlineString = false;
+			v.arenaPayload = false;
+		}
+
+		std::string_view getStringView() const
+		{
+			if (inlineString) return std::string_view(inlineText, inlineSize);
+			return borrowed ? borrowedBox->view : std::string_view(*strBox);
+		}
+
+		// uint64_t may be wider than size_t, the value is kept whole
+		Json& setUnsigned(uint64_t u)
+		{
+			if (u <= static_cast<uint64_t>(INT64_MAX)) return *this = static_cast<int64_t>(u);
+			destroy();
+			type = Type::Number;
+			numberKind = detail::NumberKind::UInt64;
+			u64 = u;
+			return *this;
+		}
+
+		// true when the string is an owned std::string, the only form that can be modified in place
+		bool isStringBox() const { return type == Type::String && !borrowed && !inlineString; }
+
+		// elements of the containers converted by the conversion operators, nested containers included
+		template <typename T> static T convertElement(const Json& json)
+		{
+			if constexpr (std::is_same_v<T, Json>) return json;
+			else
+				return json.operator T();
+		}
+
+		template <typename Container> Json& assignArray(Container&& tList)
+		{
+			using T = typename std::decay_t<Container>::value_type;
+			// vector<bool> elements are proxies, they are read as bool
+			constexpr bool moveValues = std::is_rvalue_reference_v<Container&&> && !std::is_same_v<T, bool>;
+			JsonArr tArr;
+			tArr.reserve(tList.size());
+			for (auto&& value : tList)
+			{
+				if constexpr (moveValues) tArr.emplace_back(std::move(value));
+				else
+					tArr.emplace_back(static_cast<const T&>(value));
+			}
+			return *this = std::move(tArr);
+		}
+
+		template <typename Map> Json& assignObject(Map&& tuMap)
+		{
+			using namespace std;
+			constexpr bool moveValues = std::is_rvalue_reference_v<Map&&>;
+			JsonObj tuObj;
+#ifndef SORT_JSON_OBJECT_KEYS
+			tuObj.reserve(tuMap.size());
+#endif
+			for (auto&& [key, value] : tuMap)
+			{
+#ifdef SORT_JSON_OBJECT_KEYS
+				// keys in order go at the end
+				if constexpr (moveValues) tuObj.emplace_hint(tuObj.end(), to_string(key), std::move(value));
+				else
+					tuObj.emplace_hint(tuObj.end(), to_string(key), value);
+#else
+			if constexpr (moveValues) tuObj.emplace_back(to_string(key), std::move(value));
+			else
+				tuObj.emplace_back(to_string(key), value);
+#endif
+			}
+			return *this = std::move(tuObj);
+		}
+
+		Json& assignString(const std::string_view& s_)
+		{
+			if (isStringBox())
+			{
+				*strBox = s_; // reuse the current buffer
+				escapeControlCharacters(*strBox);
+				return *this;
+			}
+			// copy before destroying the current value, s_ may point into one of its children
+			return *this = std::string(s_);
+		}
+
+		static void escapeControlCharacters(std::string& str)
+		{
+			// replace tabs and newlines with escape sequences
+			size_t pos = 0;
+			while ((pos = str.find_first_of("\t\r\n", pos)) != std::string::npos)
+			{
+				if (str[pos] == '\t') str.replace(pos, 1, "\\t");
+				else if (str[pos] == '\r')
+					str.replace(pos, 1, "\\r");
+				else
+					str.replace(pos, 1, "\\n");
+				pos += 2;
+			}
+		}
+
+		// std::string& accessors need a std::string: the first one copies the borrowed text,
+		// concurrent readers agree on a single copy through the atomic pointer
+		const std::string& getBorrowedCopy() const
+		{
+			std::string* copy = borrowedBox->copy.load(std::memory_order_acquire);
+			if (copy != nullptr) return *copy;
+			auto* newCopy = new std::string(borrowedBox->view);
+			if (borrowedBox->copy.compare_exchange_strong(copy, newCopy, std::memory_order_acq_rel, std::memory_order_acquire))
+			{
+				countAllocation(Type::String, false);
+				return *newCopy;
+			}
+			delete newCopy;
+			return *copy;
+		}
+
+		// same for the inline text, the copy is kept in the free payload pointer of the node
+		const std::string& getInlineCopy() const
+		{
+			std::string* copy = inlineCopy.load(std::memory_order_acquire);
+			if (copy != nullptr) return *copy;
+			auto* newCopy = new std::string(inlineText, inlineSize);
+			if (inlineCopy.compare_exchange_strong(copy, newCopy, std::memory_order_acq_rel, std::memory_order_acquire))
+			{
+				countAllocation(Type::String, false);
+				return *newCopy;
+			}
+			delete newCopy;
+			return *copy;
+		}
+
+		// conversions of get, the key is only used in the error message
+		template <typename T> void getAs(const std::string& key, T& value) const
+		{
+			checkKeyType(key, typeToType(value));
+			value = *this;
+		}
+		void getAs(const std::string& key, std::string& value) const
+		{
+			checkKeyType(key, Type::String);
+			value = getStringView();
+		}
+		template <typename T, typename U> void getAs(const std::string& key, std::map<T, U>& value) const
+		{
+			checkKeyType(key, Type::Object);
+			// merged: the keys already in the map get the new value, each value is converted once
+			for (const auto& [key_, val_] : objBox->obj)
+			{
+#ifdef SORT_JSON_OBJECT_KEYS
+				value.insert_or_assign(value.end(), from_string<T>(key_), convertElement<U>(val_));
+#else
+			value.insert_or_assign(from_string<T>(key_), convertElement<U>(val_));
+#endif
+			}
+		}
+		template <typename T, typename U> void getAs(const std::string& key, std::unordered_map<T, U>& value) const
+		{
+			checkKeyType(key, Type::Object);
+			value.reserve(value.size() + objBox->obj.size());
+			for (const auto& [key_, val_] : objBox->obj) value.insert_or_assign(from_string<T>(key_), convertElement<U>(val_));
+		}
+		template <typename T> void getAs(const std::string& key, std::vector<T>& value) const
+		{
+			checkKeyType(key, Type::Array);
+			value = operator std::vector<T, std::allocator<T>>();
+		}
+		template <typename T> void getAs(const std::string& key, std::deque<T>& value) const
+		{
+			checkKeyType(key, Type::Array);
+			value = operator std::deque<T, std::allocator<T>>();
+		}
+		template <typename T> void getAs(const std::string& key, std::set<T>& value) const
+		{
+			checkKeyType(key, Type::Array);
+			value = operator std::set<T, std::less<T>, std::allocator<T>>();
+		}
+		template <typename T, size_t N> void getAs(const std::string& key, std::array<T, N>& value) const
+		{
+			checkKeyType(key, Type::Array);
+			value = operator std::array<T, N>();
+		}
+
+		void checkKeyType(const std::string& key, Type expectedType) const
+		{
+			if (expectedType == Type::Null) return; // allow any type
+			if (type != expectedType)
+				throw std::runtime_error(
+					"Expected " + typeToString(expectedType) + " but got " + typeToString(type) + " for key '" + key + "'");
+		}
+
+		template <typename Sink>
+		void writeAsObject(Sink& sink, size_t currentTabCount, const std::string& tab, const std::string& newLine) const
+		{
+			if (objBox->obj.empty())
+			{
+				sink.append("{}", 2);
+				return;
+			}
+			size_t newTabCount = currentTabCount + 1;
+			const auto& newTab = getTab(tab, newTabCount);
+			bool first = true;
+			sink.append("{", 1);
+			for (const auto& p : objBox->obj)
+			{
+				if (!first) sink.append(", ", 2);
+				first = false;
+				sink.append(newLine.data(), newLine.size());
+				sink.append(newTab.data(), newTab.size());
+				sink.append("\"", 1);
+				sink.append(p.first.data(), p.first.size());
+				sink.append("\": ", 3);
+				p.second.write(sink, tab, newLine, newTabCount);
+			}
+			const auto& endTab = getTab(tab, currentTabCount);
+			sink.append(newLine.data(), newLine.size());
+			sink.append(endTab.data(), endTab.size());
+			sink.append("}", 1);
+		}
+
+		template <typename Sink>
+		void writeAsArray(Sink& sink, size_t currentTabCount, const std::string& tab, const std::string& newLine) const
+		{
+			if (arrBox->empty())
+			{
+				sink.append("[]", 2);
+				return;
+			}
+			size_t newTabCount = currentTabCount + 1;
+			const auto& newTab = getTab(tab, newTabCount);
+			bool first = true;
+			sink.append("[", 1);
+			for (const auto& v : *arrBox)
+			{
+				if (!first) sink.append(", ", 2);
+				first = false;
+				sink.append(newLine.data(), newLine.size());
+				sink.append(newTab.data(), newTab.size());
+				v.write(sink, tab, newLine, newTabCount);
+			}
+			const auto& endTab = getTab(tab, currentTabCount);
+			sink.append(newLine.data(), newLine.size());
+			sink.append(endTab.data(), endTab.size());
+			sink.append("]", 1);
+		}
+	};
+
+	// operator overloads
+	FROM_TO_JSON(bool)
+	FROM_TO_JSON(int)
+	FROM_TO_JSON(int64_t)
+	FROM_TO_JSON(size_t)
+	FROM_TO_JSON(double)
+	template <> inline std::string fromJson<std::string>(const Json& json)
+	{
+		return std::string(static_cast<std::string_view>(json));
+	}
+	template <> inline Json toJson<std::string>(const std::string& i) { return Json{i}; }
+	FROM_TO_JSON_CAST(char, int)
+	FROM_TO_JSON_CAST(short, int)
+
+	namespace detail
+	{
+
+		// JSON whitespace, same set as std::isspace in the "C" locale
+		inline bool isSpace(char c) { return c == ' ' || (c >= '\t' && c <= '\r'); }
+
+		inline bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+		// characters that stop the fast scan of a string body
+		inline bool isStringSpecial(char c) { return c == '"' || c == '\\' || c == '\n' || c == '\t' || c == '\r'; }
+
+		// Block scanners: each returns the position of the first byte in [pos, size) matching its class, or size.
+		// The SIMD versions only load full blocks inside the buffer and finish the tail with the scalar version.
+
+		inline size_t scanStringScalar(const char* data, size_t pos, size_t size)
+		{
+			while (pos < size && !isStringSpecial(data[pos])) ++pos;
+			return pos;
+		}
+
+		inline size_t skipSpaceScalar(const char* data, size_t pos, size_t size)
+		{
+			while (pos < size && isSpace(data[pos])) ++pos;
+			return pos;
+		}
+
+#ifdef BSTT_JSON_X86_SIMD
+		__attribute__((target("sse2"))) inline size_t scanStringSse2(const char* data, size_t pos, size_t size)
+		{
+			const __m128i quote = _mm_set1_epi8('"');
+			const __m128i backslash = _mm_set1_epi8('\\');
+			const __m128i newLine = _mm_set1_epi8('\n');
+			const __m128i tab = _mm_set1_epi8('\t');
+			const __m128i carriageReturn = _mm_set1_epi8('\r');
+			for (; pos + 16 <= size; pos += 16)
+			{
+				__m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos));
+				__m128i match = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(block, quote), _mm_cmpeq_epi8(block, backslash)),
+					_mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(block, newLine), _mm_cmpeq_epi8(block, tab)),
+						_mm_cmpeq_epi8(block, carriageReturn)));
+				auto mask = static_cast<unsigned>(_mm_movemask_epi8(match));
+				if (mask != 0) return pos + static_cast<size_t>(__builtin_ctz(mask));
+			}
+			return scanStringScalar(data, pos, size);
+		}
+
+		__attribute__((target("sse2"))) inline size_t skipSpaceSse2(const char* data, size_t pos, size_t size)
+		{
+			const __m128i space = _mm_set1_epi8(' ');
+			const __m128i belowTab = _mm_set1_epi8('\t' - 1);
+			const __m128i aboveCarriageReturn = _mm_set1_epi8('\r' + 1);
+			for (; pos + 16 <= size; pos += 16)
+			{
+				__m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos));
+				__m128i control = _mm_and_si128(_mm_cmpgt_epi8(block, belowTab), _mm_cmpgt_epi8(aboveCarriageReturn, block));
+				__m128i match = _mm_or_si128(_mm_cmpeq_epi8(block, space), control);
+				auto mask = static_cast<unsigned>(_mm_movemask_epi8(match)) ^ 0xFFFFU;
+				if (mask != 0) return pos + static_cast<size_t>(__builtin_ctz(mask));
+			}
+			return skipSpaceScalar(data, pos, size);
+		}
+
+		__attribute__((target("avx2"))) inline size_t scanStringAvx2(const char* data, size_t pos, size_t size)
+		{
+			const __m256i quote = _mm256_set1_epi8('"');
+			const __m256i backslash = _mm256_set1_epi8('\\');
+			const __m256i newLine = _mm256_set1_epi8('\n');
+			const __m256i tab = _mm256_set1_epi8('\t');
+			const __m256i carriageReturn = _mm256_set1_epi8('\r');
+			for (; pos + 32 <= size; pos += 32)
+			{
+				__m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + pos));
+				__m256i match = _mm256_or_si256(
+					_mm256_or_si256(_mm256_cmpeq_epi8(block, quote), _mm256_cmpeq_epi8(block, backslash)),
+					_mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(block, newLine), _mm256_cmpeq_epi8(block, tab)),
+						_mm256_cmpeq_epi8(block, carriageReturn)));
+				auto mask = static_cast<unsigned>(_mm256_movemask_epi8(match));
+				if (mask != 0) return pos + static_cast<size_t>(__builtin_ctz(mask));
+			}
+			return scanStringSse2(data, pos, size);
+		}
+
+		__attribute__((target("avx2"))) inline size_t skipSpaceAvx2(const char* data, size_t pos, size_t size)
+		{
+			const __m256i space = _mm256_set1_epi8(' ');
+			const __m256i belowTab = _mm256_set1_epi8('\t' - 1);
+			const __m256i aboveCarriageReturn = _mm256_set1_epi8('\r' + 1);
+			for (; pos + 32 <= size; pos += 32)
+			{
+				__m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + pos));
+				__m256i control =
+					_mm256_and_si256(_mm256_cmpgt_epi8(block, belowTab), _mm256_cmpgt_epi8(aboveCarriageReturn, block));
+				__m256i match = _mm256_or_si256(_mm256_cmpeq_epi8(block, space), control);
+				auto mask = ~static_cast<unsigned>(_mm256_movemask_epi8(match));
+				if (mask != 0) return pos + static_cast<size_t>(__builtin_ctz(mask));
+			}
+			return skipSpaceSse2(data, pos, size);
+		}
+#endif
+
+		struct Scanner
+		{
+			size_t (*scanString)(const char*, size_t, size_t);
+			size_t (*skipSpace)(const char*, size_t, size_t);
+		};
+
+		// the scanner is picked once, from the instruction sets of the running cpu
+		inline const Scanner& getScanner()
+		{
+			static const Scanner scanner = []() -> Scanner
+			{
+#ifdef BSTT_JSON_X86_SIMD
+				__builtin_cpu_init();
+				if (__builtin_cpu_supports("avx2")) return {scanStringAvx2, skipSpaceAvx2};
+				if (__builtin_cpu_supports("sse2")) return {scanStringSse2, skipSpaceSse2};
+#endif
+				return {scanStringScalar, skipSpaceScalar};
+			}();
+			return scanner;
+		}
+
+		inline void skipSpace(const std::string_view& str, size_t& pos)
+		{
+			// most runs are zero or one byte long, only long indentation goes through the block scanner
+			if (pos < str.size() && isSpace(str[pos])) ++pos;
+			if (pos < str.size() && isSpace(str[pos])) pos = getScanner().skipSpace(str.data(), pos + 1, str.size());
+		}
+
+		inline char peek(const std::string_view& str, size_t pos) { return pos < str.size() ? str[pos] : '\0'; }
+
+		inline bool parseChar(const std::string_view& str, size_t& pos, char c, JsonError& error)
+		{
+			if (pos >= str.size() || str[pos] != c) return fail(str, error, JsonErrorCode::ExpectedCharacter, pos, c);
+			++pos;
+			return true;
+		}
+
+		inline bool parseHex(const std::string_view& str, size_t& pos, JsonError& error)
+		{
+			if (pos >= str.size() || !std::isxdigit(static_cast<unsigned char>(str[pos])))
+				return fail(str, error, JsonErrorCode::ExpectedHexDigit, pos);
+			++pos;
+			return true;
+		}
+
+		inline bool parseEscape(const std::string_view& str, size_t& pos, JsonError& error)
+		{
+			switch (peek(str, pos))
+			{
+			case '"':
+			case '\\':
+			case '/':
+			case 'b':
+			case 'f':
+			case 'n':
+			case 'r':
+			case 't':
+				++pos;
+				return true;
+			case 'u':
+				++pos;
+				for (size_t i = 0; i < 4; ++i)
+					if (!parseHex(str, pos, error)) return false;
+				return true;
+			default:
+				return fail(str, error, JsonErrorCode::InvalidEscape, pos);
+			}
+		}
+
+		// gives the string as written in json, escape sequences are validated but not decoded
+		inline bool parseString(const std::string_view& str, size_t& pos, std::string_view& value, JsonError& error)
+		{
+			size_t start = pos;
+			const auto& scanner = getScanner();
+			while (true)
+			{
+				pos = scanner.scanString(str.data(), pos, str.size());
+				if (pos >= str.size() || str[pos] == '"') break;
+				if (str[pos] != '\\') return fail(str, error, JsonErrorCode::InvalidStringCharacter, pos);
+				++pos;
+				if (!parseEscape(str, pos, error)) return false;
+			}
+			value = str.substr(start, pos - start);
+			return parseChar(str, pos, '"', error);
+		}
+
+		inline bool parseDigits(const std::string_view& str, size_t& pos, JsonError& error)
+		{
+			if (!isDigit(peek(str, pos))) return fail(str, error, JsonErrorCode::InvalidNumber, pos);
+			while (pos < str.size() && isDigit(str[pos])) ++pos;
+			return true;
+		}
+
+		inline bool parseExponent(const std::string_view& str, size_t& pos, JsonError& error)
+		{
+			++pos;
+			if (peek(str, pos) == '+' || peek(str, pos) == '-') ++pos;
+			return parseDigits(str, pos, error);
+		}
+
+		inline bool parseDecimal(const std::string_view& str, size_t& pos, JsonError& error)
+		{
+			++pos;
+			if (!parseDigits(str, pos, error)) return false;
+			if (peek(str, pos) == 'e' || peek(str, pos) == 'E') return parseExponent(str, pos, error);
+			return true;
+		}
+
+		struct Number
+		{
+			NumberKind kind = NumberKind::Double;
+			union
+			{
+				double d = 0;
+				int64_t i;
+				uint64_t u;
+			};
+		};
+
+		// the digits of an integer are accumulated as they are validated, only other numbers are converted from text
+		inline bool parseNumber(const std::string_view& str, size_t& pos, Number& number, JsonError& error)
+		{
+			size_t start = pos;
+			bool negative = peek(str, pos) == '-';
+			if (negative) ++pos;
+			uint64_t value = 0;
+			bool overflow = false;
+			if (peek(str, pos) == '0') ++pos;
+			else if (!isDigit(peek(str, pos)))
+				return fail(str, error, JsonErrorCode::InvalidNumber, pos);
+			else
+				for (; pos < str.size() && isDigit(str[pos]); ++pos)
+				{
+					auto digit = static_cast<uint64_t>(str[pos] - '0');
+					if (value > (UINT64_MAX - digit) / 10) overflow = true;
+					value = value * 10 + digit;
+				}
+			char c = peek(str, pos);
+			bool isInteger = c != '.' && c != 'e' && c != 'E' && !overflow;
+			// -0 stays a double to keep its sign
+			if (isInteger && negative && value != 0 && value <= static_cast<uint64_t>(INT64_MAX) + 1)
+			{
+				number.kind = NumberKind::Int64;
+				number.i = static_cast<int64_t>(0 - value);
+				return true;
+			}
+			if (isInteger && !negative)
+			{
+				number.kind = value <= static_cast<uint64_t>(INT64_MAX) ? NumberKind::Int64 : NumberKind::UInt64;
+				number.u = value;
+				return true;
+			}
+			if (c == '.' && !parseDecimal(str, pos, error)) return false;
+			if ((c == 'e' || c == 'E') && !parseExponent(str, pos, error)) return false;
+			number.kind = NumberKind::Double;
+#ifdef __cpp_lib_to_chars
+			std::from_chars(str.data() + start, str.data() + pos, number.d);
+#else
+		number.d = std::stod(std::string(str.substr(start, pos - start)));
+#endif
+			return true;
+		}
+
+		template <typename Handler, typename = void> struct HasOnInteger : std::false_type
+		{
+		};
+		template <typename Handler>
+		struct HasOnInteger<Handler, std::void_t<decltype(std::declval<Handler&>().onInteger(int64_t()))>> : std::true_type
+		{
+		};
+
+		template <typename Handler, typename = void> struct HasOnUnsigned : std::false_type
+		{
+		};
+		template <typename Handler>
+		struct HasOnUnsigned<Handler, std::void_t<decltype(std::declval<Handler&>().onUnsigned(uint64_t()))>> : std::true_type
+		{
+		};
+
+		template <typename Handler> void sendNumber(Handler& handler, const Number& number)
+		{
+			switch (number.kind)
+			{
+			case NumberKind::Int64:
+				if constexpr (HasOnInteger<Handler>::value) handler.onInteger(number.i);
+				else
+					handler.onNumber(static_cast<double>(number.i));
+				break;
+			case NumberKind::UInt64:
+				if constexpr (HasOnUnsigned<Handler>::value) handler.onUnsigned(number.u);
+				else
+					handler.onNumber(static_cast<double>(number.u));
+				break;
+			case NumberKind::Double:
+				handler.onNumber(number.d);
+				break;
+			}
+		}
+
+		// Kinds of the containers being parsed, one bit per level (set for an object).
+		// The first levels are stored inline, deeper ones on the heap.
+		class ContainerStack
+		{
+		public:
+			size_t size() const { return count; }
+			bool empty() const { return count == 0; }
+			bool isObject() const { return (word(count - 1) >> ((count - 1) % 64)) & 1; }
+
+			void push(bool isObject)
+			{
+				size_t index = count / 64;
+				if (index >= INLINE_WORDS && index - INLINE_WORDS == heapWords.size()) heapWords.push_back(0);
+				uint64_t bit = uint64_t(1) << (count % 64);
+				uint64_t& w = word(count);
+				w = isObject ? w | bit : w & ~bit;
+				++count;
+			}
+
+			void pop() { --count; }
+
+		private:
+			static constexpr size_t INLINE_WORDS = 4;
+
+			uint64_t inlineWords[INLINE_WORDS] = {};
+			std::vector<uint64_t> heapWords;
+			size_t count = 0;
+
+			uint64_t& word(size_t level)
+			{
+				return level < INLINE_WORDS * 64 ? inlineWords[level / 64] : heapWords[level / 64 - INLINE_WORDS];
+			}
+			const uint64_t& word(size_t level) const { return const_cast<ContainerStack*>(this)->word(level); }
+		};
+
+		inline bool parseLiteral(const std::string_view& str, size_t& pos, const char* literal, JsonError& error)
+		{
+			for (++pos; *literal != '\0'; ++literal)
+				if (!parseChar(str, pos, *literal, error)) return false;
+			return true;
+		}
+
+		// parses the key of an object member up to its ':'
+		template <typename Handler>
+		bool parseKey(const std::string_view& str, size_t& pos, Handler& handler, JsonError& error)
+		{
+			std::string_view key;
+			if (!parseChar(str, pos, '"', error) || !parseString(str, pos, key, error)) return false;
+			handler.onKey(key);
+			skipSpace(str, pos);
+			return parseChar(str, pos, ':', error);
+		}
+
+		// Iterative parser: the containers are tracked on an explicit stack instead of the native one, so the depth
+		// limit is only a policy (see JsonParseOptions::maxDepth). depth is the level of the value in its document.
+		template <typename Handler>
+		bool parseValue(
+			const std::string_view& str, size_t& pos, Handler& handler, size_t depth, JsonError& error, size_t maxDepth)
+		{
+			ContainerStack stack;
+			for (;;)
+			{
+				// a value
+				if (depth + stack.size() >= maxDepth)
+				{
+					fail(str, error, JsonErrorCode::MaxDepthExceeded, pos);
+					error.maxDepth = maxDepth;
+					return false;
+				}
+				skipSpace(str, pos);
+				switch (peek(str, pos))
+				{
+				case 'n':
+					if (!parseLiteral(str, pos, "ull", error)) return false;
+					handler.onNull();
+					break;
+				case 't':
+					if (!parseLiteral(str, pos, "rue", error)) return false;
+					handler.onBool(true);
+					break;
+				case 'f':
+					if (!parseLiteral(str, pos, "alse", error)) return false;
+					handler.onBool(false);
+					break;
+				case '"':
+				{
+					pos++;
+					std::string_view value;
+					if (!parseString(str, pos, value, error)) return false;
+					handler.onString(value);
+					break;
+				}
+				case '[':
+				case '{':
+				{
+					bool isObject = str[pos++] == '{';
+					char close = isObject ? '}' : ']';
+					if (isObject) handler.onStartObject();
+					else
+						handler.onStartArray();
+					skipSpace(str, pos);
+					if (pos < str.size() && str[pos] != close)
+					{
+						// the first member, the container is closed once its last member is parsed
+						if (isObject && !parseKey(str, pos, handler, error)) return false;
+						stack.push(isObject);
+						continue;
+					}
+					if (!parseChar(str, pos, close, error)) return false;
+					if (isObject) handler.onEndObject();
+					else
+						handler.onEndArray();
+					break;
+				}
+				default:
+				{
+					Number number;
+					if (!parseNumber(str, pos, number, error)) return false;
+					sendNumber(handler, number);
+					break;
+				}
+				}
+				skipSpace(str, pos);
+
+				// after a value: close the finished containers, up to the next member
+				for (;;)
+				{
+					if (stack.empty()) return true;
+					bool isObject = stack.isObject();
+					char close = isObject ? '}' : ']';
+					if (pos < str.size() && str[pos] == close)
+					{
+						++pos;
+						stack.pop();
+						if (isObject) handler.onEndObject();
+						else
+							handler.onEndArray();
+						skipSpace(str, pos);
+						continue;
+					}
+					if (!parseChar(str, pos, ',', error)) return false;
+					skipSpace(str, pos);
+					if (pos < str.size() && str[pos] == close) return fail(str, error, JsonErrorCode::ExtraComma, pos);
+					if (pos >= str.size()) return parseChar(str, pos, close, error);
+					if (isObject && !parseKey(str, pos, handler, error)) return false;
+					break;
+				}
+			}
+		}
+
+		// Handler building the Json tree, this is how Json::parse uses the event parser
+		class JsonBuilder : public JsonHandler
+		{
+		public:
+			JsonBuilder(Json& root, const JsonParseOptions& options) : root(&root), options(options) {}
+
+			void onNull() { nextValue() = nullptr; }
+			void onBool(bool b) { nextValue() = b; }
+			void onNumber(double num) { nextValue() = num; }
+			void onInteger(int64_t i) { nextValue() = i; }
+			void onUnsigned(uint64_t u) { nextValue().setUnsigned(u); }
+			void onString(const std::string_view& str)
+			{
+				if (options.borrowStrings) nextValue().setBorrowedString(str, options.arena);
+				else
+					nextValue().setString(str, options.arena);
+			}
+			void onStartObject() { startContainer(JsonObj(JsonObj::allocator_type(options.arena))); }
+			void onKey(const std::string_view& key)
+			{
+				Json& object = *containerStack.back();
+				keyValue = options.keyPool != nullptr ? &object[options.keyPool->intern(key)] : &object[key];
+			}
+			void onEndObject() { containerStack.pop_back(); }
+			void onStartArray() { startContainer(JsonArr(JsonArr::allocator_type(options.arena))); }
+			void onEndArray() { containerStack.pop_back(); }
+
+			void reset()
+			{
+				containerStack.clear();
+				keyValue = nullptr;
+			}
+
+			// the next value is parsed in root, the containers being filled are forgotten
+			void setRoot(Json& newRoot)
+			{
+				root = &newRoot;
+				reset();
+			}
+
+		private:
+			Json* root;
+			const JsonParseOptions& options;
+			// containers being filled, a container does not move while one of its children is filled
+			std::vector<Json*> containerStack;
+			Json* keyValue = nullptr;
+
+			Json& nextValue()
+			{
+				if (containerStack.empty()) return *root;
+				Json& container = *containerStack.back();
+				if (container.getType() == Json::Type::Object) return *keyValue;
+				container.emplace_back();
+				return container.back();
+			}
+
+			template <typename Container> void startContainer(Container&& container)
+			{
+				Json& value = nextValue();
+				value = std::forward<Container>(container);
+				containerStack.push_back(&value);
+			}
+		};
+
+	} // namespace detail
+
+	inline bool parseValue(const std::string_view& str, size_t& pos, Json& jsonValue, size_t depth,
+		const JsonParseOptions& options, JsonError& error)
+	{
+		detail::JsonBuilder builder(jsonValue, options);
+		return detail::parseValue(str, pos, builder, depth, error, options.maxDepth);
+	}
+
+	inline void parseValue(
+		const std::string_view& str, size_t& pos, Json& jsonValue, size_t depth, const JsonParseOptions& options)
+	{
+		JsonError error;
+		if (!parseValue(str, pos, jsonValue, depth, options, error)) throw JsonParseError(error);
+	}
+
+	namespace detail
+	{
+		// Compile-time perfect hash of the keys of JsonFields<T>: every key has its own slot, so a key is dispatched to its
+		// field with one hash and one comparison, and the table is built by the compiler.
+
+		constexpr uint64_t hashFieldKey(const std::string_view& key, uint64_t seed)
+		{
+			uint64_t h = seed ^ 0xcbf29ce484222325;
+			for (size_t i = 0; i < key.size(); ++i) h = (h ^ static_cast<unsigned char>(key[i])) * 0x100000001b3;
+			h ^= h >> 29;
+			h *= 0xbf58476d1ce4e5b9;
+			return h ^ (h >> 32);
+		}
+
+		struct FieldHash
+		{
+			size_t size; // of the table, a power of two, 0 when the keys are not distinct
+			uint64_t seed;
+		};
+
+		// the smallest table, then the first seed, without collisions
+		template <size_t N> constexpr FieldHash findFieldHash(const std::array<std::string_view, N>& keys)
+		{
+			constexpr size_t MIN_SIZE = [] {
+				size_t size = 1;
+				while (size < 2 * N) size *= 2;
+				return size;
+			}();
+			constexpr size_t MAX_SIZE = MIN_SIZE * 64;
+			std::array<uint16_t, MAX_SIZE> marks{}; // the slots of each try are marked with its number
+			uint16_t tryNumber = 0;
+			for (size_t size = MIN_SIZE; size <= MAX_SIZE; size *= 2)
+				for (uint64_t seed = 0; seed < 64; ++seed)
+				{
+					++tryNumber;
+					bool perfect = true;
+					for (size_t i = 0; i < N && perfect; ++i)
+					{
+						size_t slot = hashFieldKey(keys[i], seed) & (size - 1);
+						perfect = marks[slot] != tryNumber;
+						marks[slot] = tryNumber;
+					}
+					if (perfect) return {size, seed};
+				}
+			return {0, 0};
+		}
+
+		template <size_t Size, size_t N>
+		constexpr std::array<uint16_t, Size> buildFieldSlots(const std::array<std::string_view, N>& keys, uint64_t seed)
+		{
+			std::array<uint16_t, Size> slots{};
+			for (size_t slot = 0; slot < Size; ++slot) slots[slot] = static_cast<uint16_t>(N);
+			for (size_t i = 0; i < N; ++i) slots[hashFieldKey(keys[i], seed) & (Size - 1)] = static_cast<uint16_t>(i);
+			return slots;
+		}
+
+		template <typename T> constexpr auto getFieldKeys()
+		{
+			return std::apply([](const auto&... field) { return std::array<std::string_view, sizeof...(field)>{field.name...}; },
+				JsonFields<T>::fields);
+		}
+
+		template <typename T> struct FieldHashTable
+		{
+			static constexpr auto keys = getFieldKeys<T>();
+			static constexpr size_t count = keys.size();
+			static_assert(count < UINT16_MAX, "too many fields");
+			static constexpr FieldHash hash = findFieldHash(keys);
+			static_assert(hash.size != 0, "the keys of JsonFields must be distinct");
+			static constexpr auto slots = buildFieldSlots<hash.size>(keys, hash.seed);
+
+			// index of the field of the key in JsonFields<T>::fields, count when no field has this key
+			static size_t find(const std::string_view& key)
+			{
+				size_t index = slots[hashFieldKey(key, hash.seed) & (hash.size - 1)];
+				return index < count && keys[index] == key ? index : count;
+			}
+		};
+
+		// State of Json::parseInto, a pull parser: each ValueReader reads a value at pos and the spaces after it
+		struct TypedParser
+		{
+			std::string_view str;
+			size_t pos;
+			size_t depth;
+			JsonError& error;
+			const JsonParseOptions& options;
+
+			// checks the depth of the value and gives its first character
+			bool begin(char& c)
+			{
+				if (depth >= options.maxDepth)
+				{
+					fail(str, error, JsonErrorCode::MaxDepthExceeded, pos);
+					error.maxDepth = options.maxDepth;
+					return false;
+				}
+				skipSpace(str, pos);
+				c = peek(str, pos);
+				return true;
+			}
+
+			bool end()
+			{
+				skipSpace(str, pos);
+				return true;
+			}
+
+			// an invalid value gives its syntax error, a valid one is of an unexpected type
+			bool unexpected()
+			{
+				size_t start = pos;
+				return skip() && fail(str, error, JsonErrorCode::UnexpectedType, start);
+			}
+
+			bool skip()
+			{
+				JsonHandler handler;
+				return parseValue(str, pos, handler, depth, error, options.maxDepth);
+			}
+
+			// readElement() reads the next element of the array at pos
+			template <typename ReadElement> bool readArray(ReadElement&& readElement)
+			{
+				return readContainer(']', [&] { return readElement(); });
+			}
+
+			// readMember(key) reads the value of the key, keys are given as written in json
+			template <typename ReadMember> bool readObject(ReadMember&& readMember)
+			{
+				return readContainer('}', [&] {
+					std::string_view key;
+					if (!parseChar(str, pos, '"', error) || !parseString(str, pos, key, error)) return false;
+					skipSpace(str, pos);
+					return parseChar(str, pos, ':', error) && readMember(key);
+				});
+			}
+
+		private:
+			template <typename ReadNext> bool readContainer(char close, ReadNext&& readNext)
+			{
+				++pos;
+				++depth;
+				skipSpace(str, pos);
+				if (pos < str.size() && str[pos] != close)
+					for (;;)
+					{
+						if (!readNext()) return false;
+						if (peek(str, pos) == close) break;
+						if (!parseChar(str, pos, ',', error)) return false;
+						skipSpace(str, pos);
+						if (peek(str, pos) == close) return fail(str, error, JsonErrorCode::ExtraComma, pos);
+						if (pos >= str.size()) break;
+					}
+				if (!parseChar(str, pos, close, error)) return false;
+				--depth;
+				return end();
+			}
+		};
+
+		// other types are parsed in a Json and converted by fromJson<T>
+		template <typename T, typename = void> struct ValueReader
+		{
+			static bool read(TypedParser& parser, T& value)
+			{
+				Json json;
+				JsonBuilder builder(json, parser.options);
+				if (!parseValue(parser.str, parser.pos, builder, parser.depth, parser.error, parser.options.maxDepth))
+					return false;
+				value = fromJson<T>(json);
+				return true;
+			}
+		};
+
+		template <typename T> bool readValue(TypedParser& parser, T& value) { return ValueReader<T>::read(parser, value); }
+
+		template <> struct ValueReader<Json>
+		{
+			static bool read(TypedParser& parser, Json& value)
+			{
+				JsonBuilder builder(value, parser.options);
+				return parseValue(parser.str, parser.pos, builder, parser.depth, parser.error, parser.options.maxDepth);
+			}
+		};
+
+		template <> struct ValueReader<bool>
+		{
+			static bool read(TypedParser& parser, bool& value)
+			{
+				char c;
+				if (!parser.begin(c)) return false;
+				if (c != 't' && c != 'f') return parser.unexpected();
+				value = c == 't';
+				return parseLiteral(parser.str, parser.pos, value ? "rue" : "alse", parser.error) && parser.end();
+			}
+		};
+
+		// integers are converted like the numbers of a Json
+		template <typename T> struct ValueReader<T, std::enable_if_t<std::is_arithmetic_v<T> && !std::is_same_v<T, bool>>>
+		{
+			static bool read(TypedParser& parser, T& value)
+			{
+				char c;
+				if (!parser.begin(c)) return false;
+				if (c != '-' && !isDigit(c)) return parser.unexpected();
+				Number number;
+				if (!parseNumber(parser.str, parser.pos, number, parser.error)) return false;
+				switch (number.kind)
+				{
+				case NumberKind::Int64:
+					value = static_cast<T>(number.i);
+					break;
+				case NumberKind::UInt64:
+					value = static_cast<T>(number.u);
+					break;
+				case NumberKind::Double:
+					value = static_cast<T>(number.d);
+					break;
+				}
+				return parser.end();
+			}
+		};
+
+		template <> struct ValueReader<std::string>
+		{
+			static bool read(TypedParser& parser, std::string& value)
+			{
+				char c;
+				if (!parser.begin(c)) return false;
+				if (c != '"') return parser.unexpected();
+				std::string_view text;
+				if (!parseString(parser.str, ++parser.pos, text, parser.error)) return false;
+				value.assign(text.data(), text.size());
+				return parser.end();
+			}
+		};
+
+		// std::vector and std::deque
+		template <typename Container> struct SequenceReader
+		{
+			using T = typename Container::value_type;
+
+			static bool read(TypedParser& parser, Container& value)
+			{
+				char c;
+				if (!parser.begin(c)) return false;
+				if (c != '[') return parser.unexpected();
+				value.clear();
+				return parser.readArray([&] {
+					if constexpr (std::is_same_v<T, bool>)
+					{
+						bool element = false;
+						if (!readValue(parser, element)) return false;
+						value.push_back(element);
+						return true;
+					}
+					else
+						return readValue(parser, value.emplace_back());
+				});
+			}
+		};
+
+		template <typename T, typename Allocator>
+		struct ValueReader<std::vector<T, Allocator>> : SequenceReader<std::vector<T, Allocator>>
+		{
+		};
+
+		template <typename T, typename Allocator>
+		struct ValueReader<std::deque<T, Allocator>> : SequenceReader<std::deque<T, Allocator>>
+		{
+		};
+
+		template <typename T, typename Compare, typename Allocator> struct ValueReader<std::set<T, Compare, Allocator>>
+		{
+			static bool read(TypedParser& parser, std::set<T, Compare, Allocator>& value)
+			{
+				char c;
+				if (!parser.begin(c)) return false;
+				if (c != '[') return parser.unexpected();
+				value.clear();
+				return parser.readArray([&] {
+					T element{};
+					if (!readValue(parser, element)) return false;
+					value.insert(value.end(), std::move(element));
+					return true;
+				});
+			}
+		};
+
+		// an array of another size is an unexpected type
+		template <typename T, size_t N> struct ValueReader<std::array<T, N>>
+		{
+			static bool read(TypedParser& parser, std::array<T, N>& value)
+			{
+				char c;
+				if (!parser.begin(c)) return false;
+				if (c != '[') return parser.unexpected();
+				size_t start = parser.pos;
+				size_t count = 0;
+				if (!parser.readArray([&] { return count < N ? readValue(parser, value[count++]) : (++count, parser.skip()); }))
+					return false;
+				return count == N || fail(parser.str, parser.error, JsonErrorCode::UnexpectedType, start);
+			}
+		};
+
+		template <typename T> struct ValueReader<std::optional<T>>
+		{
+			static bool read(TypedParser& parser, std::optional<T>& value)
+			{
+				char c;
+				if (!parser.begin(c)) return false;
+				if (c != 'n') return readValue(parser, value.emplace());
+				value.reset();
+				return parseLiteral(parser.str, parser.pos, "ull", parser.error) && parser.end();
+			}
+		};
+
+		// std::map and std::unordered_map with string keys
+		template <typename Map> struct ObjectReader
+		{
+			static bool read(TypedParser& parser, Map& value)
+			{
+				char c;
+				if (!parser.begin(c)) return false;
+				if (c != '{') return parser.unexpected();
+				value.clear();
+				return parser.readObject([&](const std::string_view& key) { return readValue(parser, value[std::string(key)]); });
+			}
+		};
+
+		template <typename T, typename Compare, typename Allocator>
+		struct ValueReader<std::map<std::string, T, Compare, Allocator>>
+			: ObjectReader<std::map<std::string, T, Compare, Allocator>>
+		{
+		};
+
+		template <typename T, typename Hash, typename Equal, typename Allocator>
+		struct ValueReader<std::unordered_map<std::string, T, Hash, Equal, Allocator>>
+			: ObjectReader<std::unordered_map<std::string, T, Hash, Equal, Allocator>>
+		{
+		};
+
+		// the members of the keys found in the field map are read, the values of other keys are skipped
+		template <typename T> struct ValueReader<T, std::enable_if_t<HasJsonFields<T>::value>>
+		{
+			static bool read(TypedParser& parser, T& value)
+			{
+				static constexpr auto readers = getFieldReaders(std::make_index_sequence<FieldHashTable<T>::count>());
+				char c;
+				if (!parser.begin(c)) return false;
+				if (c != '{') return parser.unexpected();
+				return parser.readObject([&](const std::string_view& key) {
+					size_t index = FieldHashTable<T>::find(key);
+					return index < FieldHashTable<T>::count ? readers[index](parser, value) : parser.skip();
+				});
+			}
+
+		private:
+			using FieldReader = bool (*)(TypedParser& parser, T& value);
+
+			template <size_t... I>
+			static constexpr std::array<FieldReader, sizeof...(I)> getFieldReaders(std::index_sequence<I...>)
+			{
+				return {&readField<I>...};
+			}
+
+			template <size_t I> static bool readField(TypedParser& parser, T& value)
+			{
+				return readValue(parser, value.*std::get<I>(JsonFields<T>::fields).member);
+			}
+		};
+
+		template <typename T>
+		bool parseInto(const std::string_view& str, T& value, JsonError& error, const JsonParseOptions& options)
+		{
+			TypedParser parser{str, 0, 0, error, options};
+			if (!readValue(parser, value)) return false;
+			return parser.pos == str.size() || fail(str, error, JsonErrorCode::ExtraCharacters, parser.pos);
+		}
+
+		// State of Json::writeValue, each ValueWriter writes a value like Json::write
+		template <typename Sink> struct TypedWriter
+		{
+			Sink& sink;
+			const std::string& tab;
+			const std::string& newLine;
+			size_t tabCount;
+
+			// writeItems(item) writes the members of the container, calling item() before each of them
+			template <typename WriteItems> void writeContainer(char open, char close, WriteItems&& writeItems)
+			{
+				const auto& itemTab = getTab(tab, tabCount + 1);
+				bool first = true;
+				sink.append(&open, 1);
+				++tabCount;
+				writeItems([&] {
+					if (!first) sink.append(", ", 2);
+					first = false;
+					sink.append(newLine.data(), newLine.size());
+					sink.append(itemTab.data(), itemTab.size());
+				});
+				--tabCount;
+				if (!first)
+				{
+					const auto& endTab = getTab(tab, tabCount);
+					sink.append(newLine.data(), newLine.size());
+					sink.append(endTab.data(), endTab.size());
+				}
+				sink.append(&close, 1);
+			}
+
+			void writeKey(const std::string_view& key)
+			{
+				sink.append("\"", 1);
+				sink.append(key.data(), key.size());
+				sink.append("\": ", 3);
+			}
+		};
+
+		// other types are converted by toJson<T>
+		template <typename T, typename = void> struct ValueWriter
+		{
+			template <typename Sink> static void write(TypedWriter<Sink>& writer, const T& value)
+			{
+				toJson<T>(value).write(writer.sink, writer.tab, writer.newLine, writer.tabCount);
+			}
+		};
+
+		template <typename Sink, typename T> void writeValue(TypedWriter<Sink>& writer, const T& value)
+		{
+			ValueWriter<T>::write(writer, value);
+		}
+
+		template <> struct ValueWriter<Json>
+		{
+			template <typename Sink> static void write(TypedWriter<Sink>& writer, const Json& value)
+			{
+				value.write(writer.sink, writer.tab, writer.newLine, writer.tabCount);
+			}
+		};
+
+		template <> struct ValueWriter<bool>
+		{
+			template <typename Sink> static void write(TypedWriter<Sink>& writer, const bool& value)
+			{
+				if (value) writer.sink.append("true", 4);
+				else
+					writer.sink.append("false", 5);
+			}
+		};
+
+		template <typename T> struct ValueWriter<T, std::enable_if_t<std::is_arithmetic_v<T> && !std::is_same_v<T, bool>>>
+		{
+			template <typename Sink> static void write(TypedWriter<Sink>& writer, const T& value)
+			{
+				char buffer[32];
+				size_t size;
+				if constexpr (std::is_floating_point_v<T>) size = formatNumber(static_cast<double>(value), buffer);
+				else
+					size = static_cast<size_t>(std::to_chars(buffer, buffer + sizeof(buffer), value).ptr - buffer);
+				writer.sink.append(buffer, size);
+			}
+		};
+
+		template <> struct ValueWriter<std::string>
+		{
+			template <typename Sink> static void write(TypedWriter<Sink>& writer, const std::string& value)
+			{
+				writer.sink.append("\"", 1);
+				// tabs and newlines are escaped like by Json::operator=(const std::string&)
+				size_t start = 0;
+				for (size_t pos; (pos = value.find_first_of("\t\r\n", start)) != std::string::npos; start = pos + 1)
+				{
+					writer.sink.append(value.data() + start, pos - start);
+					writer.sink.append(value[pos] == '\t' ? "\\t" : value[pos] == '\r' ? "\\r" : "\\n", 2);
+				}
+				writer.sink.append(value.data() + start, value.size() - start);
+				writer.sink.append("\"", 1);
+			}
+		};
+
+		// std::vector, std::deque, std::set and std::array
+		template <typename Container> struct ArrayWriter
+		{
+			template <typename Sink> static void write(TypedWriter<Sink>& writer, const Container& value)
+			{
+				using T = typename Container::value_type;
+				writer.writeContainer('[', ']', [&](auto&& item) {
+					for (const auto& element : value)
+					{
+						item();
+						writeValue(writer, static_cast<const T&>(element));
+					}
+				});
+			}
+		};
+
+		template <typename T, typename Allocator>
+		struct ValueWriter<std::vector<T, Allocator>> : ArrayWriter<std::vector<T, Allocator>>
+		{
+		};
+
+		template <typename T, typename Allocator>
+		struct ValueWriter<std::deque<T, Allocator>> : ArrayWriter<std::deque<T, Allocator>>
+		{
+		};
+
+		template <typename T, typename Compare, typename Allocator>
+		struct ValueWriter<std::set<T, Compare, Allocator>> : ArrayWriter<std::set<T, Compare, Allocator>>
+		{
+		};
+
+		template <typename T, size_t N> struct ValueWriter<std::array<T, N>> : ArrayWriter<std::array<T, N>>
+		{
+		};
+
+		template <typename T> struct ValueWriter<std::optional<T>>
+		{
+			template <typename Sink> static void write(TypedWriter<Sink>& writer, const std::optional<T>& value)
+			{
+				if (value.has_value()) writeValue(writer, *value);
+				else
+					writer.sink.append("null", 4);
+			}
+		};
+
+		// std::map and std::unordered_map, keys like Json::operator=(const std::map&)
+		template <typename Map> struct ObjectWriter
+		{
+			template <typename Sink> static void write(TypedWriter<Sink>& writer, const Map& value)
+			{
+				using Key = typename Map::key_type;
+				writer.writeContainer('{', '}', [&](auto&& item) {
+					for (const auto& [key, element] : value)
+					{
+						item();
+						if constexpr (std::is_same_v<Key, std::string>) writer.writeKey(key);
+						else
+						{
+							using namespace std;
+							writer.writeKey(to_string(key));
+						}
+						writeValue(writer, element);
+					}
+				});
+			}
+		};
+
+		template <typename Key, typename T, typename Compare, typename Allocator>
+		struct ValueWriter<std::map<Key, T, Compare, Allocator>> : ObjectWriter<std::map<Key, T, Compare, Allocator>>
+		{
+		};
+
+		template <typename Key, typename T, typename Hash, typename Equal, typename Allocator>
+		struct ValueWriter<std::unordered_map<Key, T, Hash, Equal, Allocator>>
+			: ObjectWriter<std::unordered_map<Key, T, Hash, Equal, Allocator>>
+		{
+		};
+
+		template <typename T> bool isMissingField(const T&) { return false; }
+		template <typename T> bool isMissingField(const std::optional<T>& member) { return !member.has_value(); }
+
+		// the members in the order of the field map, or of their keys like the objects of a Json with sorted keys
+		template <typename T> struct ValueWriter<T, std::enable_if_t<HasJsonFields<T>::value>>
+		{
+			template <typename Sink> static void write(TypedWriter<Sink>& writer, const T& value)
+			{
+				writer.writeContainer('{', '}', [&](auto&& item) {
+					auto writeField = [&](const auto& field) {
+						const auto& member = value.*field.member;
+						if (isMissingField(member)) return;
+						item();
+						writer.writeKey(field.name);
+						writeValue(writer, member);
+					};
+#ifdef SORT_JSON_OBJECT_KEYS
+					for (size_t index : getSortedIndexes())
+					{
+						size_t i = 0;
+						std::apply([&](const auto&... field) { ((i++ == index ? writeField(field) : void()), ...); },
+							JsonFields<T>::fields);
+					}
+#else
+				std::apply([&](const auto&... field) { (writeField(field), ...); }, JsonFields<T>::fields);
+#endif
+				});
+			}
+
+#ifdef SORT_JSON_OBJECT_KEYS
+			static const std::vector<size_t>& getSortedIndexes()
+			{
+				static const std::vector<size_t> indexes = [] {
+					std::vector<std::string_view> names;
+					std::apply([&](const auto&... field) { (names.push_back(field.name), ...); }, JsonFields<T>::fields);
+					std::vector<size_t> result(names.size());
+					for (size_t i = 0; i < result.size(); ++i) result[i] = i;
+					std::stable_sort(result.begin(), result.end(), [&](size_t a, size_t b) { return names[a] < names[b]; });
+					return result;
+				}();
+				return indexes;
+			}
+#endif
+		};
+
+		template <typename Sink, typename T>
+		void writeTyped(Sink& sink, const T& value, const std::string& tab, const std::string& newLine, size_t tabCount)
+		{
+			TypedWriter<Sink> writer{sink, tab, newLine, tabCount};
+			writeValue(writer, value);
+		}
+
+		// FROM_TO_JSON_FIELDS conversions, with the type checks of Json::get: the members of the object are dispatched to
+		// the fields by FieldHashTable. Empty optional members are left out.
+		template <typename T> struct FieldsConverter
+		{
+			static T fromJson(const Json& json)
+			{
+				static constexpr auto getters = getFieldGetters(std::make_index_sequence<FieldHashTable<T>::count>());
+				T value{};
+				if (json.getType() != Json::Type::Object)
+					throw std::runtime_error("Expected Object but got " + Json::typeToString(json.getType()));
+				for (const auto& [key, child] : json.objBox->obj)
+				{
+					size_t index = FieldHashTable<T>::find(key);
+					if (index < FieldHashTable<T>::count) getters[index](child, key, value);
+				}
+				return value;
+			}
+
+			static Json toJson(const T& value)
+			{
+				Json json = JsonObj();
+				std::apply([&](const auto&... field) { (setField(json, field.name, value.*field.member), ...); },
+					JsonFields<T>::fields);
+				return json;
+			}
+
+		private:
+			using FieldGetter = void (*)(const Json& child, const std::string& key, T& value);
+
+			template <size_t... I>
+			static constexpr std::array<FieldGetter, sizeof...(I)> getFieldGetters(std::index_sequence<I...>)
+			{
+				return {&getField<I>...};
+			}
+
+			template <size_t I> static void getField(const Json& child, const std::string& key, T& value)
+			{
+				getMember(child, key, value.*std::get<I>(JsonFields<T>::fields).member);
+			}
+
+			template <typename Member> static void getMember(const Json& child, const std::string& key, Member& member)
+			{
+				child.getAs(key, member);
+			}
+
+			template <typename Member>
+			static void getMember(const Json& child, const std::string& key, std::optional<Member>& member)
+			{
+				if (child.getType() == Json::Type::Null) member.reset();
+				else
+					child.getAs(key, member.emplace());
+			}
+
+			template <typename Member> static void setField(Json& json, const std::string_view& key, const Member& member)
+			{
+				json[key] = member;
+			}
+
+			template <typename Member>
+			static void setField(Json& json, const std::string_view& key, const std::optional<Member>& member)
+			{
+				if (member.has_value()) json[key] = *member;
+			}
+		};
+	} // namespace detail
+
+	// Parsed document owning the arena of its tree: releasing it frees all arrays and objects chunk by chunk.
+	// Copy values out of the document (Json copy = doc.getRoot()[...]) to keep them after the document is gone.
+	class JsonDocument
+	{
+	public:
+		JsonDocument() = default;
+		// the arena of the options is replaced by the document's one
+		explicit JsonDocument(const std::string_view& str, const JsonParseOptions& options = {}) { parse(str, options); }
+
+		void parse(const std::string_view& str, JsonParseOptions options = {})
+		{
+			release();
+			options.arena = &arena;
+			root = Json::parse(str, options);
+		}
+
+		bool tryParse(const std::string_view& str, const JsonParseOptions& options = {})
+		{
+			std::string error;
+			return tryParse(str, error, options);
+		}
+
+		bool tryParse(const std::string_view& str, std::string& error, JsonParseOptions options = {})
+		{
+			release();
+			options.arena = &arena;
+			return Json::tryParse(str, root, error, options);
+		}
+
+		bool tryParse(const std::string_view& str, JsonError& error, JsonParseOptions options = {})
+		{
+			release();
+			options.arena = &arena;
+			return Json::tryParse(str, root, error, options);
+		}
+
+		// the file stays open while the document is alive, so borrowed strings can point into it
+		void parseFile(const std::string& fileName, JsonParseOptions options = {})
+		{
+			release();
+			file.open(fileName);
+			options.arena = &arena;
+			root = Json::parse(file.getView(), options);
+		}
+
+		bool tryParseFile(const std::string& fileName, const JsonParseOptions& options = {})
+		{
+			std::string error;
+			return tryParseFile(fileName, error, options);
+		}
+
+		bool tryParseFile(const std::string& fileName, std::string& error, JsonParseOptions options = {})
+		{
+			release();
+			if (!file.tryOpen(fileName, error)) return false;
+			options.arena = &arena;
+			return Json::tryParse(file.getView(), root, error, options);
+		}
+
+		void release()
+		{
+			root = nullptr;
+			arena.release();
+			file.close();
+		}
+
+		Json& getRoot() { return root; }
+		const Json& getRoot() const { return root; }
+		const JsonArena& getArena() const { return arena; }
+
+	private:
+		JsonFile file;
+		JsonArena arena;
+		Json root; // declared after the file and the arena, so it is destroyed first
+	};
+
+	// Reader of JSON Lines (newline-delimited json): each non-blank line is a document, parsed by next() in the same value,
+	// whose containers are allocated in an arena reused from line to line (see Json::parseLines).
+	// An invalid line does not stop the reading: getError() tells it, with its offset and line in the whole text.
+	class JsonLineReader
+	{
+	public:
+		// the text must outlive the reader, the arena of the options is replaced by the reader's one
+		explicit JsonLineReader(const std::string_view& str = {}, const JsonParseOptions& options = {}) :
+			str(str), options(options)
+		{
+			this->options.arena = &arena;
+		}
+
+		// the file stays open while the reader is alive, so borrowed strings can point into it
+		void openFile(const std::string& fileName)
+		{
+			clear();
+			file.open(fileName);
+			str = file.getView();
+		}
+
+		bool tryOpenFile(const std::string& fileName, std::string& error)
+		{
+			clear();
+			if (!file.tryOpen(fileName, error)) return false;
+			str = file.getView();
+			return true;
+		}
+
+		// parses the next non-blank line, returns false at the end of the text
+		bool next()
+		{
+			while (pos < str.size())
+			{
+				line = detail::nextLine(str, pos);
+				++lineNumber;
+				if (detail::isBlankLine(line)) continue;
+				error = JsonError();
+				value = nullptr;
+				arena.reset();
+				Json::tryParseLine(str, line, lineNumber, value, options, error);
+				return true;
+			}
+			line = {};
+			value = nullptr;
+			return false;
+		}
+
+		// the value of the current line, null when it is invalid
+		Json& getValue() { return value; }
+		const Json& getValue() const { return value; }
+		const JsonError& getError() const { return error; }
+		size_t getLineNumber() const { return lineNumber; }
+		std::string_view getLine() const { return line; }
+		const JsonArena& getArena() const { return arena; }
+
+	private:
+		JsonFile file;
+		JsonArena arena;
+		Json value; // declared after the file and the arena, so it is destroyed first
+		std::string_view str;
+		JsonParseOptions options;
+		size_t pos = 0;
+		size_t lineNumber = 0;
+		std::string_view line;
+		JsonError error;
+
+		// forgets the text, before the file is replaced
+		void clear()
+		{
+			value = nullptr;
+			str = {};
+			pos = 0;
+			lineNumber = 0;
+			line = {};
+			error = JsonError();
+		}
+	};
+
+	namespace detail
+	{
+		// Base of the parallel parsers, the text being cut in batches of records by the derived parser (Derived::cut).
+		// Derived::parseBatch(batch, options, newRecord, done) parses the records of a batch, which are handed to
+		// Derived::deliver. In order, each batch in progress has its slot (records and arena), the calling thread
+		// delivering the records of the slots one batch after the other. Otherwise each thread parses its records one by
+		// one in its value and arena, and delivers them itself.
+		template <typename Derived> class ParallelParser
+		{
+		protected:
+			struct Record
+			{
+				Json value;
+				JsonError error;
+				size_t number = 0; // line number or index of the element
+			};
+
+			ParallelParser(const std::string_view& str, const JsonParallelOptions& parallel, const JsonParseOptions& options) :
+				str(str), ordered(parallel.ordered), batchSize(std::max<size_t>(parallel.batchSize, 1)), options(options)
+			{
+				threadCount = parallel.threadCount != 0 ? parallel.threadCount : std::thread::hardware_concurrency();
+				threadCount = std::max<size_t>(threadCount, 1);
+			}
+
+			std::string_view str;
+			bool ordered;
+			bool useArenas = true; // false when the delivered values are moved out
+			size_t batchSize;
+			size_t threadCount;
+			JsonParseOptions options;
+			std::vector<size_t> batchStarts; // and the end of the last batch
+			std::vector<size_t> firstNumbers; // number of the first record of each batch
+
+			size_t getBatchCount() const { return batchStarts.size() - 1; }
+
+			std::string_view getBatch(size_t batch) const
+			{
+				return str.substr(batchStarts[batch], batchStarts[batch + 1] - batchStarts[batch]);
+			}
+
+			// work runs in the threads, main in the calling thread: the first exception stops them all
+			template <typename Work, typename Main> void runThreads(size_t workThreadCount, Work work, Main main)
+			{
+				auto guarded = [this](auto function)
+				{
+					try
+					{
+						function();
+					}
+					catch (...)
+					{
+						std::lock_guard<std::mutex> lock(mutex);
+						if (!exception) exception = std::current_exception();
+						stop = true;
+						condition.notify_all();
+					}
+				};
+				nextBatch = 0;
+				std::vector<std::thread> threads;
+				for (size_t i = 0; i < workThreadCount; ++i) threads.emplace_back([&] { guarded(work); });
+				guarded(main);
+				for (auto& thread : threads) thread.join();
+				if (exception) std::rethrow_exception(exception);
+			}
+
+			// calls function(index) for the indexes up to count, shared by all the threads
+			template <typename Function> void forEachParallel(size_t count, Function function)
+			{
+				auto work = [&]
+				{
+					for (size_t i = nextBatch++; i < count && !isStopped(); i = nextBatch++) function(i);
+				};
+				runThreads(std::min(threadCount, count) - (count != 0), work, work);
+			}
+
+			// stops the threads, nothing more is delivered
+			void cancel()
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				stop = true;
+				condition.notify_all();
+			}
+
+			bool isStopped() const { return stop; }
+
+			void parseBatches()
+			{
+				size_t batchCount = getBatchCount();
+				if (ordered)
+				{
+					size_t slotCount = 2 * std::min(threadCount, batchCount);
+					slots.reset(new Slot[slotCount]);
+					for (size_t i = 0; i < slotCount; ++i) slots[i].batch = i;
+					runThreads(
+						slotCount / 2, [&] { parseOrdered(slotCount); }, [&] { deliverOrdered(slotCount); });
+				}
+				else
+					forEachParallel(batchCount, [this](size_t batch) { parseUnordered(batch); });
+			}
+
+		private:
+			struct Slot
+			{
+				JsonArena arena;
+				std::vector<Record> records; // declared after the arena, so they are destroyed first
+				size_t batch = 0;			 // the batch expected in the slot
+				bool ready = false;			 // the batch is parsed
+			};
+
+			std::atomic<size_t> nextBatch{0};
+			std::unique_ptr<Slot[]> slots;
+			std::mutex mutex;
+			std::condition_variable condition;
+			std::atomic<bool> stop{false}; // set with the mutex locked, for the waiting threads
+			std::exception_ptr exception;
+
+			Derived& derived() { return static_cast<Derived&>(*this); }
+
+			void parseUnordered(size_t batch)
+			{
+				JsonArena arena;
+				JsonParseOptions batchOptions = options;
+				batchOptions.arena = useArenas ? &arena : nullptr;
+				Record record; // declared after the arena, so it is destroyed first
+				derived().parseBatch(
+					batch, batchOptions,
+					[&]() -> Record&
+					{
+						record.value = nullptr; // before the arena holding the previous record is reset
+						arena.reset();
+						record.error = JsonError();
+						return record;
+					},
+					[&](Record& parsed)
+					{
+						if (!isStopped()) derived().deliver(parsed);
+					});
+			}
+
+			void parseOrdered(size_t slotCount)
+			{
+				for (size_t batch = nextBatch++; batch < getBatchCount(); batch = nextBatch++)
+				{
+					Slot& slot = slots[batch % slotCount];
+					{
+						std::unique_lock<std::mutex> lock(mutex);
+						condition.wait(lock, [&] { return stop || slot.batch == batch; });
+						if (stop) return;
+					}
+					slot.records.clear();
+					slot.arena.reset();
+					JsonParseOptions slotOptions = options;
+					slotOptions.arena = useArenas ? &slot.arena : nullptr;
+					derived().parseBatch(
+						batch, slotOptions, [&]() -> Record& { return slot.records.emplace_back(); }, [](Record&) {});
+					std::lock_guard<std::mutex> lock(mutex);
+					slot.ready = true;
+					condition.notify_all();
+				}
+			}
+
+			void deliverOrdered(size_t slotCount)
+			{
+				for (size_t batch = 0; batch < getBatchCount(); ++batch)
+				{
+					Slot& slot = slots[batch % slotCount];
+					{
+						std::unique_lock<std::mutex> lock(mutex);
+						condition.wait(lock, [&] { return stop || slot.ready; });
+						if (stop) return;
+					}
+					for (Record& record : slot.records)
+					{
+						derived().deliver(record);
+						if (isStopped()) return;
+					}
+					std::lock_guard<std::mutex> lock(mutex);
+					slot.ready = false;
+					slot.batch = batch + slotCount;
+					condition.notify_all();
+				}
+			}
+		};
+
+		// Json::parseLines with JsonParallelOptions: batches of lines cut at line ends, whose lines are counted first
+		template <typename Callback, typename ErrorCallback>
+		class ParallelLineParser : public ParallelParser<ParallelLineParser<Callback, ErrorCallback>>
+		{
+			using Base = ParallelParser<ParallelLineParser>;
+			using Record = typename Base::Record;
+			friend Base;
+
+		public:
+			ParallelLineParser(const std::string_view& str, Callback& callback, ErrorCallback& onError,
+				const JsonParallelOptions& parallel, const JsonParseOptions& options) :
+				Base(str, parallel, options), callback(callback), onError(onError)
+			{
+			}
+
+			// returns the number of invalid lines
+			size_t run()
+			{
+				batchStarts.push_back(0);
+				for (size_t cut = batchSize; cut < str.size(); cut += batchSize)
+				{
+					if (cut <= batchStarts.back()) continue; // in a line longer than a batch
+					size_t end = str.find('\n', cut - 1);
+					if (end == std::string_view::npos || end + 1 == str.size()) break;
+					batchStarts.push_back(end + 1);
+				}
+				batchStarts.push_back(str.size());
+
+				firstNumbers.resize(this->getBatchCount());
+				this->forEachParallel(this->getBatchCount(),
+					[this](size_t batch)
+					{
+						std::string_view text = this->getBatch(batch);
+						firstNumbers[batch] = static_cast<size_t>(std::count(text.begin(), text.end(), '\n'));
+					});
+				for (size_t batch = 0, lineNumber = 1; batch < firstNumbers.size(); ++batch)
+					lineNumber += std::exchange(firstNumbers[batch], lineNumber);
+
+				this->parseBatches();
+				return errorCount;
+			}
+
+		private:
+			using Base::batchSize;
+			using Base::batchStarts;
+			using Base::firstNumbers;
+			using Base::str;
+
+			Callback& callback;
+			ErrorCallback& onError;
+			std::atomic<size_t> errorCount{0};
+
+			template <typename NewRecord, typename Done>
+			void parseBatch(size_t batch, const JsonParseOptions& batchOptions, NewRecord newRecord, Done done)
+			{
+				std::string_view text = this->getBatch(batch);
+				size_t lineNumber = firstNumbers[batch];
+				for (size_t pos = 0; pos < text.size(); ++lineNumber)
+				{
+					std::string_view line = nextLine(text, pos);
+					if (isBlankLine(line)) continue;
+					Record& record = newRecord();
+					record.number = lineNumber;
+					Json::tryParseLine(str, line, lineNumber, record.value, batchOptions, record.error);
+					done(record);
+				}
+			}
+
+			void deliver(Record& record)
 			{
-				findIndex = ind + 1;
-				return obj.begin() + static_cast<long long>(ind);
+				if (!record.error) callback(record.value, record.number);
+				else
+				{
+					++errorCount;
+					onError(static_cast<const JsonError&>(record.error));
+				}
 			}
-		}
-		return obj.end();
-#endif
-		}
+		};
 
-		JsonObj::const_iterator objFind(const std::string& key) const
-		{
-#ifdef SORT_JSON_OBJECT_KEYS
-			return obj.find(key);
-#else
-		// search most efficient when keys are accessed in order
-		// findIndex is mutable, so it can be modified in const methods
-		for (size_t i = 0; i < obj.size(); ++i)
+		// Json::parseElements: the elements of the top level array are cut in batches at commas found by a structural
+		// scan of blocks of text, in two parallel passes. The first one counts the quotes of each block, so the blocks
+		// starting in a string are known. The second one finds the depth change of each block and its first comma of
+		// lowest depth, which separates two elements of the array when it is at depth 1. The scan trusts the text: any
+		// error is given by the sequential parser, so the result is always the one of Json::parse.
+		template <typename Callback> class ParallelArrayParser : public ParallelParser<ParallelArrayParser<Callback>>
 		{
-			auto ind = (findIndex + i) % obj.size();
-			if (obj[ind].first == key)
+			using Base = ParallelParser<ParallelArrayParser>;
+			using Record = typename Base::Record;
+			friend Base;
+
+		public:
+			// with moveValues, the callback may move the values: they are not allocated in arenas
+			ParallelArrayParser(const std::string_view& str, Callback& callback, const JsonParallelOptions& parallel,
+				const JsonParseOptions& options, bool moveValues) :
+				Base(str, parallel, options), callback(callback)
 			{
-				findIndex = ind + 1;
-				return obj.begin() + static_cast<long long>(ind);
+				this->useArenas = !moveValues;
 			}
-		}
-		return obj.end();
-#endif
-		}
 
-	public:
-		bool hasKey(const std::string& key) const
-		{
-			auto it = objFind(key);
-			if (it != obj.end())
+			// false when the text is not an array, or not valid
+			bool cut()
 			{
-#ifndef SORT_JSON_OBJECT_KEYS
-				// decrement findIndex since next search will probably be the same key
-				// findIndex is mutable, so it can be modified in const methods
-				findIndex--;
-#endif
+				size_t pos = 0;
+				skipSpace(str, pos);
+				if (pos >= str.size() || str[pos] != '[') return false;
+
+				std::vector<Block> blockList((str.size() + batchSize - 1) / batchSize);
+				this->forEachParallel(blockList.size(), [&](size_t block) { countQuotes(blockList[block], block); });
+				for (size_t block = 1; block < blockList.size(); ++block)
+					blockList[block].inString = blockList[block - 1].inString != blockList[block - 1].oddQuotes;
+				this->forEachParallel(blockList.size(), [&](size_t block) { scanDepth(blockList[block], block); });
+
+				batchStarts.push_back(pos + 1);
+				firstNumbers.push_back(0);
+				size_t end = std::string_view::npos;
+				ptrdiff_t depth = 0;
+				for (const Block& block : blockList)
+				{
+					if (block.commaPos != std::string_view::npos && depth + block.commaDepth == 1)
+					{
+						batchStarts.push_back(block.commaPos);
+						firstNumbers.push_back(elementCount + 1);
+						elementCount += block.commaCount;
+					}
+					if (block.minPos != std::string_view::npos && depth + block.minDepth <= 0)
+					{
+						if (depth + block.minDepth < 0) return false;
+						end = block.minPos;
+						break;
+					}
+					depth += block.depthChange;
+				}
+				// a '}' closing the array is left to the sequential parser, for its error
+				if (end == std::string_view::npos || str[end] != ']') return false;
+				size_t after = end + 1;
+				skipSpace(str, after);
+				if (after != str.size()) return false;
+				batchStarts.push_back(end);
+
+				// no comma: one element, or none
+				size_t first = pos + 1;
+				skipSpace(str, first);
+				if (elementCount != 0 || first != end) ++elementCount;
 				return true;
 			}
-			return false;
-		}
 
-		template <typename T> bool tryGet(const std::string& key, T& value) const
-		{
-			auto it = objFind(key);
-			if (it != obj.end()) value = it->second;
-			return it != obj.end();
-		}
-		bool tryGet(const std::string& key, std::string& value) const
-		{
-			auto it = objFind(key);
-			if (it != obj.end())
+			size_t getElementCount() const { return elementCount; }
+			bool isParallel() const { return this->threadCount > 1; }
+
+			// false with the error of the sequential parser when the text is not valid
+			bool run(JsonError& error)
 			{
-				it->second.checkKeyType(key, Type::String);
-				value = std::string(it->second.str);
+				this->parseBatches();
+				if (!invalid) return true;
+				JsonHandler handler;
+				return Json::tryParseEvents(str, handler, error, this->options.maxDepth);
 			}
-			return it != obj.end();
-		}
-		template <typename T, typename U> bool tryGet(const std::string& key, std::map<T, U>& value) const
-		{
-			auto it = objFind(key);
-			if (it != obj.end())
+
+		private:
+			using Base::batchSize;
+			using Base::batchStarts;
+			using Base::firstNumbers;
+			using Base::str;
+
+			struct Block
 			{
-				it->second.checkKeyType(key, Type::Object);
-				for (const auto& [k, val] : it->second.obj) value[from_string<T>(k)] = val;
-			}
-			return it != obj.end();
-		}
-		template <typename T> bool tryGet(const std::string& key, std::vector<T>& value) const
-		{
-			auto it = objFind(key);
-			if (it != obj.end())
+				bool oddQuotes = false; // odd count of unescaped quotes
+				bool inString = false;	// at the start of the block
+				ptrdiff_t depthChange = 0;
+				ptrdiff_t minDepth = PTRDIFF_MAX; // lowest depth after a closing bracket, from the start of the block
+				size_t minPos = std::string_view::npos;
+				ptrdiff_t commaDepth = PTRDIFF_MAX; // lowest depth of a comma
+				size_t commaPos = std::string_view::npos;
+				size_t commaCount = 0;
+			};
+
+			Callback& callback;
+			size_t elementCount = 0;
+			std::atomic<bool> invalid{false};
+
+			// a quote is escaped by an odd number of backslashes, which may be in the previous block
+			bool isEscaped(size_t pos) const
 			{
-				it->second.checkKeyType(key, Type::Array);
-				value = std::vector<T>(it->second);
+				size_t slashes = 0;
+				while (pos > slashes && str[pos - slashes - 1] == '\\') ++slashes;
+				return slashes % 2 != 0;
 			}
-			return it != obj.end();
-		}
-		template <typename T, typename... Args> bool tryGet(const std::string& key, T& value, Args&&... args) const
-		{
-			bool allFound = tryGet(key, value);
-			return tryGet(std::forward(args)...) && allFound;
-		}
 
-		// Array functions
-
-		const Json& back() const { return arr.back(); }
-		Json& back() { return arr.back(); }
-		const Json& operator[](size_t index) const { return arr[index]; }
-		const Json& operator[](int index) const { return arr[index]; }
-		// resize the array if needed
-		Json& operator[](size_t index)
-		{
-			if (type != Type::Array) *this = JsonArr();
-			if (arr.size() <= index) arr.resize(index + 1);
-			return arr[index];
-		}
-		Json& operator[](int index) { return (*this)[static_cast<size_t>(index)]; }
-		template <typename... Args> void emplace_back(Args&&... args)
-		{
-			if (type != Type::Array) *this = JsonArr();
-			arr.emplace_back(std::forward<Args>(args)...);
-		}
+			// the next unescaped quote from pos, end if none
+			size_t findQuote(size_t pos, size_t end) const
+			{
+				for (;; ++pos)
+				{
+					auto quote = static_cast<const char*>(std::memchr(str.data() + pos, '"', end - pos));
+					if (quote == nullptr) return end;
+					pos = static_cast<size_t>(quote - str.data());
+					if (!isEscaped(pos)) return pos;
+				}
+			}
 
-		void resize(size_t size) { arr.resize(size); }
+			void countQuotes(Block& block, size_t index) const
+			{
+				size_t begin = index * batchSize, end = std::min(begin + batchSize, str.size());
+				for (size_t pos = findQuote(begin, end); pos != end; pos = findQuote(pos + 1, end))
+					block.oddQuotes = !block.oddQuotes;
+			}
 
-		// Object functions
+			void scanDepth(Block& block, size_t index) const
+			{
+				size_t begin = index * batchSize, end = std::min(begin + batchSize, str.size());
+				size_t pos = block.inString ? findQuote(begin, end) + 1 : begin; // after the string
+				ptrdiff_t depth = 0;
+				for (; pos < end; ++pos)
+				{
+					switch (str[pos])
+					{
+					case '"':
+						if (!isEscaped(pos)) pos = findQuote(pos + 1, end);
+						break;
+					case '[':
+					case '{':
+						++depth;
+						break;
+					case ']':
+					case '}':
+						if (--depth < block.minDepth)
+						{
+							block.minDepth = depth;
+							block.minPos = pos;
+						}
+						break;
+					case ',':
+						if (depth < block.commaDepth)
+						{
+							block.commaDepth = depth;
+							block.commaPos = pos;
+							block.commaCount = 0;
+						}
+						if (depth == block.commaDepth) ++block.commaCount;
+						break;
+					}
+				}
+				block.depthChange = depth;
+			}
 
-		const Json& operator[](const std::string& key) const
-		{
-			auto it = objFind(key);
-			if (it == obj.end())
+			template <typename NewRecord, typename Done>
+			void parseBatch(size_t batch, const JsonParseOptions& batchOptions, NewRecord newRecord, Done done)
 			{
-#ifdef BSTT_JSON_DEBUG
-				std::cerr << "Key not found: '" << key << "'" << std::endl;
-				std::cerr << this->toString() << std::endl;
-#endif
-				throw std::runtime_error("Key not found: '" + key + "'");
+				size_t pos = batchStarts[batch] + (batch != 0); // after the comma
+				size_t end = batchStarts[batch + 1];
+				size_t index = firstNumbers[batch];
+				if (elementCount == 0) return;
+				Json unused;
+				JsonBuilder builder(unused, batchOptions);
+				for (;;)
+				{
+					Record& record = newRecord();
+					record.number = index++;
+					builder.setRoot(record.value);
+					if (!parseValue(str, pos, builder, 1, record.error, batchOptions.maxDepth) || pos > end
+						|| (pos < end && str[pos] != ','))
+					{
+						invalid = true;
+						this->cancel();
+						return;
+					}
+					done(record);
+					if (pos++ == end) return;
+				}
 			}
-			return it->second;
-		}
-		const Json& operator[](const char* key) const { return (*this)[std::string(key)]; }
 
-		Json& operator[](const std::string& key) { return (*this)[key.c_str()]; }
-		Json& operator[](const char* key)
-		{
-			if (type != Type::Object) *this = JsonObj();
-#ifdef SORT_JSON_OBJECT_KEYS
-			return obj[key];
-#else
-		auto it = objFind(key);
-		if (it == obj.end())
-		{
-			obj.emplace_back(key, Json());
-			return obj.back().second;
-		}
-		return it->second;
-#endif
-		}
+			void deliver(Record& record) { callback(record.value, record.number); }
+		};
+	} // namespace detail
 
-		// Display
+	inline Json Json::parse(const std::string_view& str, const JsonParallelOptions& parallel, const JsonParseOptions& options)
+	{
+		Json json;
+		JsonError error;
+		if (!tryParse(str, json, error, parallel, options)) throw JsonParseError(error);
+		return json;
+	}
 
-		std::string toString(const std::string& tab = "", const std::string& newLine = "") const
+	inline bool Json::tryParse(const std::string_view& str, Json& json, JsonError& error, const JsonParallelOptions& parallel,
+		const JsonParseOptions& options)
+	{
+		JsonParseOptions heapOptions = options;
+		heapOptions.arena = nullptr;
+		JsonParallelOptions orderedParallel = parallel;
+		orderedParallel.ordered = true;
+		JsonArr arr;
+		auto append = [&arr](Json& element, size_t) { arr.push_back(std::move(element)); };
+		detail::ParallelArrayParser<decltype(append)> parser(str, append, orderedParallel, heapOptions, true);
+		if (!parser.isParallel() || !parser.cut()) return tryParse(str, json, error, heapOptions);
+		error = JsonError();
+		arr.reserve(parser.getElementCount());
+		if (!parser.run(error)) return false;
+		json = std::move(arr);
+		return true;
+	}
+
+	// Push parser: feed the json text in chunks of any size, the handler receives the same events as with
+	// Json::parseEvents as soon as each token is complete. Only a token split by two chunks is copied.
+	template <typename Handler> class JsonPushEventParser
+	{
+	public:
+		explicit JsonPushEventParser(Handler& handler, size_t maxDepth = MAX_JSON_DEPTH) : handler(handler), maxDepth(maxDepth)
 		{
-			std::ostringstream ostr;
-			display(ostr, tab, newLine);
-			return ostr.str();
 		}
 
-		friend std::ostream& operator<<(std::ostream& os, const Json& v) { return v.display(os); }
-
-		std::ostream& display(
-			std::ostream& os, const std::string& tab = "", const std::string& newLine = "", size_t currentTabCount = 0) const
+		void feed(const std::string_view& chunk)
 		{
-			switch (type)
+			size_t pos = 0;
+			if (token != Token::None) pos = continueToken(chunk, 0);
+			while (pos < chunk.size())
 			{
-			case Type::Null:
-				return os << "null";
-			case Type::Bool:
-				return os << (b ? "true" : "false");
-			case Type::Number:
-				return os << num;
-			case Type::String:
-				return os << '"' << str << '"';
-			case Type::Object:
-				return displayAsObject(os, currentTabCount, tab, newLine);
-			case Type::Array:
-				return displayAsArray(os, currentTabCount, tab, newLine);
+				if (detail::isSpace(chunk[pos]))
+				{
+					detail::skipSpace(chunk, pos);
+					continue;
+				}
+				pos = parseStructure(chunk, pos);
 			}
-			return os;
+			offset += chunk.size();
 		}
 
-		void writeToFile(const std::string& fileName, const std::string& tab = "", const std::string& newLine = "") const
+		// to call after the last chunk, checks that the document is complete
+		void finish()
 		{
-			std::ofstream ofs(fileName);
-			ofs << toString(tab, newLine);
+			if (token == Token::Number) endNumber(tokenBuffer);
+			else if (token == Token::Literal)
+				throw error(JsonErrorCode::ExpectedCharacter, 0, *literal);
+			else if (token != Token::None)
+				throw error(JsonErrorCode::ExpectedCharacter, 0, '"');
+			if (state == State::Done) return;
+			if (containerStack.empty()) throw error(JsonErrorCode::InvalidNumber, 0);
+			throw error(JsonErrorCode::ExpectedCharacter, 0, containerStack.back() == '{' ? '}' : ']');
 		}
 
-		// Getters
-
-		Type getType() const { return type; }
-
-		size_t size() const
+		// forget the current document, to parse a new one
+		void reset()
 		{
-			if (type == Type::Array) return arr.size();
-			if (type == Type::Object) return obj.size();
-			return 0;
+			state = State::Value;
+			token = Token::None;
+			containerStack.clear();
+			tokenBuffer.clear();
+			escape = false;
+			hexCount = 0;
+			literal = nullptr;
+			offset = 0;
 		}
 
-	private:
-		Type type = Type::Null;
+		// number of bytes fed since the start of the document
+		size_t getPosition() const { return offset; }
 
-		union
+	private:
+		enum class State : uint8_t
 		{
-			std::string str;
-			bool b;
-			double num;
-			JsonArr arr;
-			JsonObj obj;
+			Value,		 // a value is expected
+			ArrayFirst,	 // a value or the end of the array
+			ObjectFirst, // a key or the end of the object
+			Key,
+			Colon,
+			AfterValue, // a comma or the end of the container
+			Done		// the top level value is complete
 		};
 
-#ifndef SORT_JSON_OBJECT_KEYS
-		mutable size_t findIndex = 0;
-#endif
-
-		void get() const {}
-		static bool tryGet() { return true; }
-		void set() {}
-
-		void checkKeyType(const std::string& key, Type expectedType) const
-		{
-			if (expectedType == Type::Null) return; // allow any type
-			if (type != expectedType)
-				throw std::runtime_error(
-					"Expected " + typeToString(expectedType) + " but got " + typeToString(type) + " for key '" + key + "'");
-		}
-
-		std::ostream& displayAsObject(
-			std::ostream& os, size_t currentTabCount, const std::string& tab, const std::string& newLine) const
-		{
-			if (obj.empty()) return os << "{}";
-			size_t newTabCount = currentTabCount + 1;
-			const auto& newTab = getTab(tab, newTabCount);
-			auto it = obj.begin();
-			auto beforeEnd = obj.size() - 1;
-			os << "{";
-			for (size_t i = 0; i < beforeEnd; ++i, ++it)
-				it->second.display(os << newLine << newTab << '"' << it->first << "\": ", tab, newLine, newTabCount) << ", ";
-			return it->second.display(os << newLine << newTab << '"' << it->first << "\": ", tab, newLine, newTabCount)
-				   << newLine << getTab(tab, currentTabCount) << "}";
-		}
-
-		std::ostream& displayAsArray(
-			std::ostream& os, size_t currentTabCount, const std::string& tab, const std::string& newLine) const
+		enum class Token : uint8_t
 		{
-			if (arr.empty()) return os << "[]";
-			size_t newTabCount = currentTabCount + 1;
-			const auto& newTab = getTab(tab, newTabCount);
-			auto it = arr.begin();
-			auto beforeEnd = arr.size() - 1;
-			os << "[";
-			for (size_t i = 0; i < beforeEnd; ++i, ++it) it->display(os << newLine << newTab, tab, newLine, newTabCount) << ", ";
-			return it->display(os << newLine << newTab, tab, newLine, newTabCount)
-				   << newLine << getTab(tab, currentTabCount) << "]";
-		}
-	};
-
-	// operator overloads
-	FROM_TO_JSON(bool)
-	FROM_TO_JSON(int)
-	FROM_TO_JSON(int64_t)
-	FROM_TO_JSON(size_t)
-	FROM_TO_JSON(double)
-	template <> inline std::string fromJson<std::string>(const Json& json) { return static_cast<const std::string&>(json); }
-	template <> inline Json toJson<std::string>(const std::string& i) { return Json{i}; }
-	FROM_TO_JSON_CAST(char, int)
-	FROM_TO_JSON_CAST(short, int)
+			None,
+			String,
+			Key,
+			Number,
+			Literal
+		};
 
-	namespace detail
-	{
+		Handler& handler;
+		size_t maxDepth;
+		State state = State::Value;
+		Token token = Token::None;
+		std::vector<char> containerStack; // '{' or '['
+		std::string tokenBuffer;		  // start of the token split by two chunks
+		bool escape = false;			  // in a string, after a backslash
+		uint8_t hexCount = 0;			  // in a string, hex digits left in a \u escape
+		const char* literal = nullptr;	  // rest of true, false or null still expected
+		char literalStart = 0;
+		size_t tokenStart = 0;			  // position of the current number in the document
+		size_t offset = 0;				  // position of the current chunk in the document
 
-		inline void skipSpace(const std::string_view& str, size_t& pos)
+		// the line and column are not known, the previous chunks are gone
+		JsonParseError errorAt(JsonErrorCode code, size_t position, char expected = '\0') const
 		{
-			while (pos < str.size() && std::isspace(str[pos])) ++pos;
+			JsonError jsonError;
+			jsonError.code = code;
+			jsonError.expected = expected;
+			jsonError.offset = position;
+			jsonError.maxDepth = maxDepth;
+			return JsonParseError(jsonError);
 		}
 
-		inline void parseChar(const std::string_view& str, size_t& pos, char c)
+		// pos is in the current chunk
+		JsonParseError error(JsonErrorCode code, size_t pos, char expected = '\0') const
 		{
-			if (pos >= str.size() || str[pos] != c)
-				throw std::runtime_error("Expected '" + std::string(1, c) + "' at position " + std::to_string(pos));
-			++pos;
+			return errorAt(code, offset + pos, expected);
 		}
 
-		inline void parseHex(const std::string_view& str, size_t& pos)
+		size_t parseStructure(const std::string_view& chunk, size_t pos)
 		{
-			if (!std::isxdigit(str[pos])) throw std::runtime_error("Expected hex digit at position " + std::to_string(pos));
-			++pos;
+			char c = chunk[pos];
+			switch (state)
+			{
+			case State::ArrayFirst:
+				if (c == ']') return endContainer(pos);
+				return startValue(chunk, pos);
+			case State::Value:
+				if (c == ']' && !containerStack.empty()) throw error(JsonErrorCode::ExtraComma, pos);
+				return startValue(chunk, pos);
+			case State::ObjectFirst:
+			case State::Key:
+				if (c == '}')
+				{
+					if (state == State::Key) throw error(JsonErrorCode::ExtraComma, pos);
+					return endContainer(pos);
+				}
+				if (c != '"') throw error(JsonErrorCode::ExpectedCharacter, pos, '"');
+				token = Token::Key;
+				return scanString(chunk, pos + 1);
+			case State::Colon:
+				if (c != ':') throw error(JsonErrorCode::ExpectedCharacter, pos, ':');
+				state = State::Value;
+				return pos + 1;
+			case State::AfterValue:
+				if (c == ',')
+				{
+					state = containerStack.back() == '{' ? State::Key : State::Value;
+					return pos + 1;
+				}
+				if (c == (containerStack.back() == '{' ? '}' : ']')) return endContainer(pos);
+				throw error(JsonErrorCode::ExpectedCharacter, pos, ',');
+			case State::Done:
+				break;
+			}
+			throw error(JsonErrorCode::ExtraCharacters, pos);
 		}
 
-		inline void parseEscape(const std::string_view& str, size_t& pos)
+		size_t startValue(const std::string_view& chunk, size_t pos)
 		{
-			switch (str[pos])
+			if (containerStack.size() >= maxDepth) throw error(JsonErrorCode::MaxDepthExceeded, pos);
+			switch (chunk[pos])
 			{
 			case '"':
-			case '\\':
-			case '/':
-			case 'b':
-			case 'f':
-			case 'n':
-			case 'r':
+				token = Token::String;
+				return scanString(chunk, pos + 1);
+			case '{':
+				containerStack.push_back('{');
+				state = State::ObjectFirst;
+				handler.onStartObject();
+				return pos + 1;
+			case '[':
+				containerStack.push_back('[');
+				state = State::ArrayFirst;
+				handler.onStartArray();
+				return pos + 1;
 			case 't':
-				++pos;
+				literal = "rue";
 				break;
-			case 'u':
-				++pos;
-				for (size_t i = 0; i < 4; ++i) parseHex(str, pos);
+			case 'f':
+				literal = "alse";
+				break;
+			case 'n':
+				literal = "ull";
 				break;
 			default:
-				throw std::runtime_error("Invalid escape character at position " + std::to_string(pos));
+				if (chunk[pos] != '-' && !detail::isDigit(chunk[pos])) throw error(JsonErrorCode::InvalidNumber, pos);
+				token = Token::Number;
+				tokenStart = offset + pos;
+				return scanNumber(chunk, pos);
+			}
+			token = Token::Literal;
+			literalStart = chunk[pos];
+			return scanLiteral(chunk, pos + 1);
+		}
+
+		size_t continueToken(const std::string_view& chunk, size_t pos)
+		{
+			switch (token)
+			{
+			case Token::String:
+			case Token::Key:
+				return scanString(chunk, pos);
+			case Token::Number:
+				return scanNumber(chunk, pos);
+			case Token::Literal:
+				return scanLiteral(chunk, pos);
+			case Token::None:
+				break;
 			}
+			return pos;
 		}
 
-		inline void parseString(const std::string_view& str, size_t& pos, std::string& value)
+		size_t scanString(const std::string_view& chunk, size_t pos)
 		{
 			size_t start = pos;
-			while (str[pos] != '"' && pos < str.size())
+			const auto& scanner = detail::getScanner();
+			while (pos < chunk.size())
 			{
-				if (str[pos] == '\\')
+				if (hexCount > 0)
 				{
+					if (!std::isxdigit(static_cast<unsigned char>(chunk[pos])))
+						throw error(JsonErrorCode::ExpectedHexDigit, pos);
+					--hexCount;
 					++pos;
-					parseEscape(str, pos);
+					continue;
 				}
-				else if (str[pos] == '\n' || str[pos] == '\t' || str[pos] == '\r')
-					throw std::runtime_error("Invalid character in string at position " + std::to_string(pos));
-				else
+				if (escape)
+				{
+					if (chunk[pos] == 'u') hexCount = 4;
+					else if (std::string_view("\"\\/bfnrt").find(chunk[pos]) == std::string_view::npos)
+						throw error(JsonErrorCode::InvalidEscape, pos);
+					escape = false;
 					++pos;
+					continue;
+				}
+				pos = scanner.scanString(chunk.data(), pos, chunk.size());
+				if (pos == chunk.size()) break;
+				if (chunk[pos] == '"')
+				{
+					endString(joinToken(chunk.substr(start, pos - start)));
+					return pos + 1;
+				}
+				if (chunk[pos] != '\\') throw error(JsonErrorCode::InvalidStringCharacter, pos);
+				escape = true;
+				++pos;
 			}
-			value = str.substr(start, pos - start);
-			parseChar(str, pos, '"');
+			tokenBuffer.append(chunk.substr(start));
+			return chunk.size();
 		}
 
-		inline void parseDigits(const std::string_view& str, size_t& pos)
+		size_t scanNumber(const std::string_view& chunk, size_t pos)
 		{
-			if (!std::isdigit(str[pos])) throw std::runtime_error("Invalid number at position " + std::to_string(pos));
-			while (std::isdigit(str[pos])) ++pos;
+			size_t start = pos;
+			auto isNumberChar = [](char c)
+			{ return detail::isDigit(c) || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E'; };
+			while (pos < chunk.size() && isNumberChar(chunk[pos])) ++pos;
+			if (pos == chunk.size())
+			{
+				// the number may go on in the next chunk
+				tokenBuffer.append(chunk.substr(start));
+				return pos;
+			}
+			endNumber(joinToken(chunk.substr(start, pos - start)));
+			return pos;
 		}
 
-		inline void parseExponent(const std::string_view& str, size_t& pos)
+		size_t scanLiteral(const std::string_view& chunk, size_t pos)
 		{
-			++pos;
-			if (str[pos] == '+' || str[pos] == '-') ++pos;
-			parseDigits(str, pos);
+			for (; *literal != '\0'; ++literal, ++pos)
+			{
+				if (pos == chunk.size()) return pos;
+				if (chunk[pos] != *literal) throw error(JsonErrorCode::ExpectedCharacter, pos, *literal);
+			}
+			token = Token::None;
+			if (literalStart == 'n') handler.onNull();
+			else
+				handler.onBool(literalStart == 't');
+			endValue();
+			return pos;
 		}
 
-		inline void parseDecimal(const std::string_view& str, size_t& pos)
+		// the complete token, copied only if it started in a previous chunk
+		std::string_view joinToken(const std::string_view& end)
 		{
-			++pos;
-			parseDigits(str, pos);
-			if (str[pos] == 'e' || str[pos] == 'E') parseExponent(str, pos);
+			if (tokenBuffer.empty()) return end;
+			tokenBuffer.append(end);
+			return tokenBuffer;
 		}
 
-		inline void parseNumber(const std::string_view& str, size_t& pos, double& value)
+		void endString(const std::string_view& str)
 		{
-			size_t start = pos;
-			if (str[pos] == '-') ++pos;
-			if (str[pos] == '0')
+			if (token == Token::Key)
 			{
-				++pos;
-				if (str[pos] == '.') parseDecimal(str, pos);
-				else if (str[pos] == 'e' || str[pos] == 'E')
-					parseExponent(str, pos);
+				handler.onKey(str);
+				state = State::Colon;
 			}
 			else
 			{
-				parseDigits(str, pos);
-				if (str[pos] == '.') parseDecimal(str, pos);
-				else if (str[pos] == 'e' || str[pos] == 'E')
-					parseExponent(str, pos);
+				handler.onString(str);
+				endValue();
 			}
-#ifdef __cpp_lib_to_chars
-			std::from_chars(str.data() + start, str.data() + pos, value);
-#else
-		value = std::stod(std::string(str.substr(start, pos - start)));
-#endif
+			token = Token::None;
+			tokenBuffer.clear();
 		}
 
-		inline void parseObject(const std::string_view& str, size_t& pos, Json& jsonValue, size_t depth)
+		void endNumber(const std::string_view& text)
 		{
-			skipSpace(str, pos);
-			if (str[pos] == '}') jsonValue = JsonObj();
-			while (pos < str.size() && str[pos] != '}')
-			{
-				parseChar(str, pos, '"');
-				std::string key;
-				parseString(str, pos, key);
-				skipSpace(str, pos);
-				parseChar(str, pos, ':');
-				parseValue(str, pos, jsonValue[key], depth + 1);
-				if (str[pos] == '}') break;
-				parseChar(str, pos, ',');
-				skipSpace(str, pos);
-				if (str[pos] == '}') throw std::runtime_error("Extra comma at position " + std::to_string(pos));
-			}
-			parseChar(str, pos, '}');
+			detail::Number number;
+			size_t pos = 0;
+			JsonError numberError;
+			if (!detail::parseNumber(text, pos, number, numberError) || pos != text.size())
+				throw errorAt(JsonErrorCode::InvalidNumber, tokenStart);
+			token = Token::None;
+			tokenBuffer.clear();
+			detail::sendNumber(handler, number);
+			endValue();
 		}
 
-		inline void parseArray(const std::string_view& str, size_t& pos, Json& jsonValue, size_t depth)
+		size_t endContainer(size_t pos)
 		{
-			jsonValue = JsonArr();
-			while (pos < str.size() && str[pos] != ']')
-			{
-				jsonValue.emplace_back();
-				parseValue(str, pos, jsonValue.back(), depth + 1);
-				if (str[pos] == ']') break;
-				parseChar(str, pos, ',');
-				skipSpace(str, pos);
-				if (str[pos] == ']') throw std::runtime_error("Extra comma at position " + std::to_string(pos));
-			}
-			parseChar(str, pos, ']');
+			char container = containerStack.back();
+			containerStack.pop_back();
+			if (container == '{') handler.onEndObject();
+			else
+				handler.onEndArray();
+			endValue();
+			return pos + 1;
 		}
 
-	} // namespace detail
+		void endValue() { state = containerStack.empty() ? State::Done : State::AfterValue; }
+	};
 
-	inline void parseValue(const std::string_view& str, size_t& pos, Json& jsonValue, size_t depth)
+	// Push parser building a Json, see JsonPushEventParser. The strings are always copied since the chunks do not outlive
+	// the parser.
+	class JsonPushParser
 	{
-		using namespace detail;
-
-		if (depth == MAX_JSON_DEPTH) throw std::runtime_error("Exceeded maximum depth of " + std::to_string(MAX_JSON_DEPTH));
-
-		skipSpace(str, pos);
-		switch (str[pos])
-		{
-		case 'n':
-			pos++;
-			parseChar(str, pos, 'u');
-			parseChar(str, pos, 'l');
-			parseChar(str, pos, 'l');
-			break;
-		case 't':
-			pos++;
-			jsonValue = true;
-			parseChar(str, pos, 'r');
-			parseChar(str, pos, 'u');
-			parseChar(str, pos, 'e');
-			break;
-		case 'f':
-			pos++;
-			jsonValue = false;
-			parseChar(str, pos, 'a');
-			parseChar(str, pos, 'l');
-			parseChar(str, pos, 's');
-			parseChar(str, pos, 'e');
-			break;
-		case '"':
-			pos++;
-			parseString(str, pos, jsonValue);
-			break;
-		case '[':
-			pos++;
-			parseArray(str, pos, jsonValue, depth);
-			break;
-		case '{':
-			pos++;
-			parseObject(str, pos, jsonValue, depth);
-			break;
-		default:
-			parseNumber(str, pos, jsonValue);
-			break;
-		}
-		skipSpace(str, pos);
-	}
+	public:
+		explicit JsonPushParser(const JsonParseOptions& options = {}) :
+			options(options), builder(root, this->options), parser(builder, options.maxDepth)
+		{
+			this->options.borrowStrings = false;
+		}
+		JsonPushParser(const JsonPushParser&) = delete;
+		JsonPushParser& operator=(const JsonPushParser&) = delete;
+
+		void feed(const std::string_view& chunk) { parser.feed(chunk); }
+
+		// returns the parsed value, the parser is ready for a new document
+		Json finish()
+		{
+			parser.finish();
+			Json result = std::move(root);
+			reset();
+			return result;
+		}
+
+		void reset()
+		{
+			parser.reset();
+			builder.reset();
+			root = nullptr;
+		}
+
+	private:
+		JsonParseOptions options;
+		Json root;
+		detail::JsonBuilder builder;
+		JsonPushEventParser<detail::JsonBuilder> parser;
+	};
+
 #ifdef USE_BSTT_NAMESPACE
 } // namespace bstt
 #endif
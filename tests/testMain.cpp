@@ -1,11 +1,33 @@
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#define BSTT_JSON_COUNT_ALLOCATIONS
 #include "../bsttJson.hpp"
 #include "doctest.h"
 #include <fstream>
+#include <cstdlib>
+#include <cstring>
 #include <map>
+#include <optional>
+#include <random>
 #include <sstream>
+#include <thread>
 #include <vector>
 
+// Heap allocations of the current thread, counted by the replaced operator new
+static thread_local size_t heapAllocationCount = 0;
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete" // the replaced operators pair malloc and free
+#endif
+
+void* operator new(size_t size)
+{
+	++heapAllocationCount;
+	if (void* p = std::malloc(size == 0 ? 1 : size)) return p;
+	throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
 // Test basic type construction and assignment
 TEST_CASE("Basic Types - Null")
 {
@@ -544,6 +566,138 @@ TEST_CASE("Parsing - Extra characters error")
 	CHECK(!error.empty());
 }
 
+TEST_CASE("Parsing - Structured errors")
+{
+	struct Case
+	{
+		const char* text;
+		JsonErrorCode code;
+		size_t offset;
+		size_t line;
+		size_t column;
+		const char* message;
+	};
+	const Case caseList[] = {
+		{"[1, 2", JsonErrorCode::ExpectedCharacter, 5, 1, 6, "Expected ',' at position 5"},
+		{"{\n  \"a\": 1,\n  \"b\" 2}", JsonErrorCode::ExpectedCharacter, 18, 3, 7, "Expected ':' at position 18"},
+		{"\"\\u12G4\"", JsonErrorCode::ExpectedHexDigit, 5, 1, 6, "Expected hex digit at position 5"},
+		{"\"\\x\"", JsonErrorCode::InvalidEscape, 2, 1, 3, "Invalid escape character at position 2"},
+		{"\"a\tb\"", JsonErrorCode::InvalidStringCharacter, 2, 1, 3, "Invalid character in string at position 2"},
+		{"[-]", JsonErrorCode::InvalidNumber, 2, 1, 3, "Invalid number at position 2"},
+		{"1.", JsonErrorCode::InvalidNumber, 2, 1, 3, "Invalid number at position 2"},
+		{"[1,]", JsonErrorCode::ExtraComma, 3, 1, 4, "Extra comma at position 3"},
+		{"\n\n42 x", JsonErrorCode::ExtraCharacters, 5, 3, 4, "Extra characters at position 5"},
+		{"tru", JsonErrorCode::ExpectedCharacter, 3, 1, 4, "Expected 'e' at position 3"},
+	};
+	for (const auto& c : caseList)
+	{
+		CAPTURE(std::string(c.text));
+		Json json;
+		JsonError error;
+		CHECK(Json::tryParse(c.text, json, error) == false);
+		CHECK(static_cast<bool>(error));
+		CHECK(error.code == c.code);
+		CHECK(error.offset == c.offset);
+		CHECK(error.line == c.line);
+		CHECK(error.column == c.column);
+		CHECK(error.toString() == c.message);
+
+		std::string message;
+		CHECK(Json::tryParse(c.text, json, message) == false);
+		CHECK(message == c.message);
+	}
+
+	Json json;
+	JsonError error;
+	CHECK(Json::tryParse("[1, {\"a\": null}]", json, error));
+	CHECK(!error);
+	CHECK(error.toString().empty());
+
+	std::string deep(MAX_JSON_DEPTH + 1, '[');
+	CHECK(Json::tryParse(deep, json, error) == false);
+	CHECK(error.code == JsonErrorCode::MaxDepthExceeded);
+	CHECK(error.toString() == "Exceeded maximum depth of " + std::to_string(MAX_JSON_DEPTH));
+}
+
+TEST_CASE("Parsing - Depth limit")
+{
+	// objects and arrays alternate, beyond the levels kept inline by the parser
+	const size_t depth = 5000;
+	std::string text;
+	size_t limitOffset = 0; // where the value beyond the default limit starts
+	for (size_t i = 0; i < depth; ++i)
+	{
+		if (i == MAX_JSON_DEPTH) limitOffset = text.size();
+		text += i % 3 == 0 ? "{\"k\":" : "[0,";
+	}
+	text += "null";
+	for (size_t i = depth; i-- > 0;) text += i % 3 == 0 ? "}" : "]";
+
+	Json json;
+	JsonError error;
+	CHECK(Json::tryParse(text, json, error) == false);
+	CHECK(error.code == JsonErrorCode::MaxDepthExceeded);
+	CHECK(error.offset == limitOffset);
+
+	JsonParseOptions options;
+	options.maxDepth = depth + 1;
+	REQUIRE(Json::tryParse(text, json, error, options));
+	const Json* value = &json;
+	for (size_t i = 0; i < depth; ++i) value = i % 3 == 0 ? &(*value)["k"] : &(*value)[1];
+	CHECK(value->getType() == Json::Type::Null);
+
+	options.maxDepth = depth;
+	CHECK(Json::tryParse(text, json, error, options) == false);
+	CHECK(error.toString() == "Exceeded maximum depth of " + std::to_string(depth));
+
+	// no tree is built by event parsing, so the depth is only limited by the memory
+	std::string deep = std::string(100000, '[') + std::string(100000, ']');
+	JsonHandler handler;
+	CHECK(Json::tryParseEvents(deep, handler, error) == false);
+	CHECK(Json::tryParseEvents(deep, handler, error, 100000));
+	CHECK(Json::tryParseEvents(deep, handler, error, 99999) == false);
+	CHECK(error.offset == 99999);
+
+	// the limit counts the levels of the values, from 0 for the root
+	options.maxDepth = 3;
+	CHECK(Json::tryParse("[[1]]", json, error, options));
+	CHECK(Json::tryParse("[[], {\"a\": [], \"b\": 1}]", json, error, options));
+	CHECK(Json::tryParse("[[[1]]]", json, error, options) == false);
+	CHECK(error.offset == 3);
+
+	JsonPushParser pushParser(options);
+	pushParser.feed("[[[");
+	CHECK_THROWS_AS(pushParser.feed("1"), JsonParseError);
+}
+
+TEST_CASE("Parsing - Parse throws a JsonParseError")
+{
+	try
+	{
+		Json::parse("{\"a\": [1, 2,]}");
+		FAIL("no exception");
+	}
+	catch (const JsonParseError& e)
+	{
+		CHECK(e.getError().code == JsonErrorCode::ExtraComma);
+		CHECK(e.getError().offset == 12);
+		CHECK(std::string(e.what()) == "Extra comma at position 12");
+	}
+	CHECK_THROWS_AS(Json::parse("nul"), std::runtime_error);
+
+	JsonHandler handler;
+	JsonError error;
+	CHECK(Json::tryParseEvents("[1 2]", handler, error) == false);
+	CHECK(error.code == JsonErrorCode::ExpectedCharacter);
+	CHECK(error.expected == ',');
+	CHECK_THROWS_AS(Json::parseEvents("[1 2]", handler), JsonParseError);
+
+	JsonDocument doc;
+	CHECK(doc.tryParse("{", error) == false);
+	CHECK(error.code == JsonErrorCode::ExpectedCharacter);
+	CHECK(error.expected == '}');
+}
+
 TEST_CASE("Type Conversions - Int to Json and back")
 {
 	int original = 42;
@@ -613,6 +767,110 @@ TEST_CASE("Type Conversions - Map with string values")
 	CHECK(converted == original);
 }
 
+// no default constructor: the map conversions must construct each value from its Json
+struct Meters
+{
+	explicit Meters(double value) : value(value) {}
+	double value;
+};
+
+template <> inline Meters fromJson<Meters>(const Json& json) { return Meters(static_cast<double>(json)); }
+
+TEST_CASE("Type Conversions - Map values are constructed once")
+{
+	Json json = Json::parse(R"({"distances": {"b": 2, "a": 1.5}})");
+	std::map<std::string, Meters> distances = json["distances"];
+	CHECK(distances.at("a").value == 1.5);
+
+	// get and tryGet merge: the keys already there get the new value
+	std::map<std::string, Meters> merged = {{"a", Meters(9)}, {"c", Meters(3)}};
+	json.get("distances", merged);
+	CHECK(merged.size() == 3);
+	CHECK(merged.at("a").value == 1.5);
+	CHECK(merged.at("c").value == 3);
+	std::unordered_map<std::string, Meters> unorderedMerged = {{"b", Meters(9)}};
+	CHECK(json.tryGet("distances", unorderedMerged));
+	CHECK(unorderedMerged.size() == 2);
+	CHECK(unorderedMerged.at("b").value == 2);
+	std::unordered_map<std::string, Meters> unorderedDistances = json["distances"];
+	CHECK(unorderedDistances.at("a").value == 1.5);
+	CHECK(!json.tryGet("missing", merged));
+}
+
+TEST_CASE("Type Conversions - Other containers")
+{
+	std::unordered_map<std::string, int> unorderedMap = {{"a", 1}, {"b", 2}};
+	std::array<int, 3> array = {1, 2, 3};
+	std::deque<std::string> deque = {"x", "y"};
+	std::set<int> set = {3, 1, 2};
+	Json json;
+	json["unorderedMap"] = unorderedMap;
+	json["array"] = array;
+	json["deque"] = deque;
+	json["set"] = set;
+	json["nested"] = std::vector<std::vector<int>>{{1}, {2, 3}};
+	CHECK(static_cast<int>(json["unorderedMap"]["b"]) == 2);
+	CHECK(json["array"].toString() == "[1, 2, 3]");
+	CHECK(json["deque"].toString() == R"(["x", "y"])");
+	CHECK(json["set"].toString() == "[1, 2, 3]");
+	CHECK(json["nested"].toString() == "[[1], [2, 3]]");
+
+	std::unordered_map<std::string, int> unorderedMap2 = json["unorderedMap"];
+	std::array<int, 3> array2 = json["array"];
+	std::deque<std::string> deque2 = json["deque"];
+	std::set<int> set2 = json["set"];
+	std::vector<std::vector<int>> nested = json["nested"];
+	CHECK(unorderedMap2 == unorderedMap);
+	CHECK(array2 == array);
+	CHECK(deque2 == deque);
+	CHECK(set2 == set);
+	CHECK(nested == std::vector<std::vector<int>>{{1}, {2, 3}});
+
+	std::array<int, 2> wrongSize;
+	CHECK_THROWS_AS(json.get("array", wrongSize), std::runtime_error);
+
+	// get merges maps like std::map and replaces sequences
+	std::unordered_map<std::string, int> unorderedMap3 = {{"c", 3}};
+	std::array<int, 3> array3{};
+	std::deque<std::string> deque3 = {"z"};
+	std::set<int> set3 = {9};
+	json.get("unorderedMap", unorderedMap3, "array", array3, "deque", deque3, "set", set3);
+	CHECK(unorderedMap3.size() == 3);
+	CHECK(array3 == array);
+	CHECK(deque3 == deque);
+	CHECK(set3 == set);
+
+	// rvalue containers move their elements, Json elements included
+	std::vector<Json> jsonList = {Json("a"), Json(1)};
+	Json fromJsonList = std::move(jsonList);
+	CHECK(fromJsonList.toString() == R"(["a", 1])");
+	std::map<std::string, Json> jsonMap = json;
+	CHECK(jsonMap.size() == 5);
+	CHECK(static_cast<int>(jsonMap["array"][2]) == 3);
+}
+
+TEST_CASE("Typed parsing - Other containers")
+{
+	CHECK(Json::parseAs<std::array<int, 2>>("[1, 2]") == std::array<int, 2>{1, 2});
+	CHECK(Json::parseAs<std::deque<int>>("[1, 2]") == std::deque<int>{1, 2});
+	CHECK(Json::parseAs<std::set<int>>("[2, 1, 2]") == std::set<int>{1, 2});
+	CHECK(Json::parseAs<std::unordered_map<std::string, int>>(R"({"a": 1})") == std::unordered_map<std::string, int>{{"a", 1}});
+
+	// an array of another size is an unexpected type
+	std::array<int, 2> array;
+	JsonError error;
+	CHECK(!Json::tryParseInto("[1]", array, error));
+	CHECK(error.code == JsonErrorCode::UnexpectedType);
+	CHECK(!Json::tryParseInto(" [1, 2, [3]]", array, error));
+	CHECK(error.code == JsonErrorCode::UnexpectedType);
+	CHECK(error.offset == 1);
+
+	CHECK(Json::valueToString(std::array<int, 2>{1, 2}) == Json(std::array<int, 2>{1, 2}).toString());
+	CHECK(Json::valueToString(std::deque<int>{1, 2}) == "[1, 2]");
+	CHECK(Json::valueToString(std::set<int>{2, 1}) == "[1, 2]");
+	CHECK(Json::valueToString(std::unordered_map<int, bool>{{1, true}}) == R"({"1": true})");
+}
+
 TEST_CASE("ToString - Basic types")
 {
 	Json json1 = 42;
@@ -660,6 +918,104 @@ TEST_CASE("ToString - Formatting with tabs")
 	CHECK(formatted.find("    ") != std::string::npos);
 }
 
+TEST_CASE("ToString - Numbers")
+{
+	const std::pair<double, const char*> numberList[] = {{0, "0"}, {-0.0, "-0"}, {1, "1"}, {-1, "-1"}, {1000000, "1000000"},
+		{123456789, "123456789"}, {9007199254740991.0, "9007199254740991"}, {9007199254740992.0, "9007199254740992"},
+		{-9007199254740991.0, "-9007199254740991"}, {3.14159265358979, "3.14159265358979"}, {0.1, "0.1"}, {1e-7, "1e-07"},
+		{19.99, "19.99"}, {1.5e300, "1.5e+300"}, {5e-324, "5e-324"}, {1e21, "1e+21"}, {0.5, "0.5"},
+		{-2.2250738585072014e-308, "-2.2250738585072014e-308"}, {1.7976931348623157e308, "1.7976931348623157e+308"}};
+	for (const auto& [num, text] : numberList)
+	{
+		CAPTURE(text);
+		CHECK(Json(num).toString() == text);
+		CHECK(Json(num).estimateSize() >= Json(num).toString().size());
+	}
+}
+
+TEST_CASE("ToString - Numbers round trip")
+{
+	std::mt19937_64 random(42);
+	std::uniform_real_distribution<double> price(0, 10000);
+	for (int i = 0; i < 100000; i++)
+	{
+		// any bit pattern but infinities and nans, then values of usual magnitude
+		double num;
+		if (i % 2 == 0)
+		{
+			uint64_t bits = random();
+			std::memcpy(&num, &bits, sizeof(num));
+			if (!std::isfinite(num)) continue;
+		}
+		else
+			num = price(random);
+		std::string text = Json(num).toString();
+		double parsed = static_cast<double>(Json::parse(text));
+		CAPTURE(text);
+		REQUIRE(std::memcmp(&parsed, &num, sizeof(num)) == 0);
+	}
+}
+
+TEST_CASE("ToString - Same text through all outputs")
+{
+	Json json = Json::parse(R"({"a": [1, 2.5, {"b": null, "c": [], "d": {}}], "e": "text", "f": [true, false]})");
+	CHECK(json.toString() == R"({"a": [1, 2.5, {"b": null, "c": [], "d": {}}], "e": "text", "f": [true, false]})");
+	CHECK(json.toString("\t", "\n")
+		  == "{\n\t\"a\": [\n\t\t1, \n\t\t2.5, \n\t\t{\n\t\t\t\"b\": null, \n\t\t\t\"c\": [], \n\t\t\t\"d\": {}\n\t\t}\n\t], "
+			 "\n\t\"e\": \"text\", \n\t\"f\": [\n\t\ttrue, \n\t\tfalse\n\t]\n}");
+	CHECK(json.estimateSize() >= json.toString().size());
+	CHECK(json.estimateSize(2, 1) >= json.toString("  ", "\n").size());
+
+	std::ostringstream oss;
+	oss << json;
+	CHECK(oss.str() == json.toString());
+
+	// no digit is lost
+	std::ostringstream precise;
+	precise << Json(3.14159265358979);
+	CHECK(precise.str() == "3.14159265358979");
+
+	// any sink with append(const char*, size_t)
+	std::string appended = "x = ";
+	json["a"].write(appended);
+	CHECK(appended == R"(x = [1, 2.5, {"b": null, "c": [], "d": {}}])");
+}
+
+TEST_CASE("ToString - Large document")
+{
+	Json json;
+	for (int i = 0; i < 1000; i++)
+	{
+		json["key" + std::to_string(i)] = Json::parse(R"({"list": [1.25, -3, "value"], "flag": true})");
+		json["key" + std::to_string(i)]["index"] = i;
+	}
+	std::string compact = json.toString();
+	std::string pretty = json.toString("  ", "\n");
+	CHECK(Json::parse(compact).toString() == compact);
+	CHECK(Json::parse(pretty).toString("  ", "\n") == pretty);
+	// the size estimate does not stay in the result
+	std::string numbers = Json(std::vector<int>(10000, 1)).toString();
+	CHECK(numbers.capacity() <= 2 * numbers.size());
+
+	std::ostringstream oss;
+	json.display(oss, "  ", "\n");
+	CHECK(oss.str() == pretty);
+}
+
+TEST_CASE("ToString - Allocations")
+{
+	Json json = Json::parse("[[1], [2], [3], [4], [5], [6], [7], [8], [9], [10]]");
+	std::string pretty = json.toString("  ", "\n"); // the first call caches the indentations of the thread
+	for (auto [tab, newLine] : {std::pair<std::string, std::string>{"", ""}, {"  ", "\n"}})
+	{
+		CAPTURE(tab);
+		size_t before = heapAllocationCount;
+		std::string text = json.toString(tab, newLine);
+		// the result, and its shrink when the size estimate overshot
+		CHECK(heapAllocationCount - before <= 2);
+	}
+}
+
 TEST_CASE("Copy Constructor")
 {
 	Json original;
@@ -804,6 +1160,96 @@ TEST_CASE("File operations - TryParseFile")
 	(void)std::remove(filename.c_str());
 }
 
+TEST_CASE("File operations - Missing and empty files")
+{
+	Json read;
+	std::string error;
+	CHECK(Json::tryParseFile("missing_file.json", read, error) == false);
+	CHECK(error == "Cannot open file missing_file.json");
+	CHECK_THROWS_AS(Json::parseFile("missing_file.json"), std::runtime_error);
+
+	const std::string filename = "test_empty_file.json";
+	{
+		std::ofstream ofs(filename);
+	}
+	CHECK(Json::tryParseFile(filename, read, error) == false);
+	JsonFile file(filename);
+	CHECK(file.getView().empty());
+	CHECK(file.isMapped() == false);
+	file.close();
+	(void)std::remove(filename.c_str());
+}
+
+TEST_CASE("File operations - JsonFile")
+{
+	const std::string filename = "test_file.json";
+	std::string content = "[";
+	for (int i = 0; i < 10000; i++) content += std::to_string(i) + ",";
+	content.back() = ']';
+	{
+		std::ofstream ofs(filename, std::ios::binary);
+		ofs << content;
+	}
+
+	JsonFile file(filename);
+	CHECK(file.getView() == content);
+#ifdef BSTT_JSON_POSIX_FILE
+	CHECK(file.isMapped());
+#endif
+	JsonFile moved(std::move(file));
+	CHECK(file.getView().empty());
+	CHECK(moved.getView() == content);
+
+	Json read = Json::parseFile(filename);
+	CHECK(read.size() == 10000);
+	CHECK(static_cast<int>(read[9999]) == 9999);
+	(void)std::remove(filename.c_str());
+}
+
+TEST_CASE("File operations - Document keeps the file for borrowed strings")
+{
+	const std::string filename = "test_file.json";
+	{
+		std::ofstream ofs(filename, std::ios::binary);
+		ofs << R"({"name": "John", "list": ["a", "b"]})";
+	}
+
+	JsonParseOptions options;
+	options.borrowStrings = true;
+	JsonDocument doc;
+	doc.parseFile(filename, options);
+	CHECK(doc.getRoot()["name"].isBorrowedString());
+	CHECK(static_cast<std::string_view>(doc.getRoot()["name"]) == "John");
+	CHECK(static_cast<std::string_view>(doc.getRoot()["list"][1]) == "b");
+
+	std::string error;
+	CHECK(doc.tryParseFile("missing_file.json", error) == false);
+	CHECK(doc.getRoot().getType() == Json::Type::Null);
+
+	// Json::parseFile closes the file, the strings are copied
+	Json read = Json::parseFile(filename, options);
+	CHECK(read["name"].isBorrowedString() == false);
+	CHECK(static_cast<const std::string&>(read["name"]) == "John");
+	(void)std::remove(filename.c_str());
+}
+
+#ifdef BSTT_JSON_POSIX_FILE
+TEST_CASE("File operations - Read fallback")
+{
+	// a pipe cannot be mapped
+	int fds[2];
+	REQUIRE(pipe(fds) == 0);
+	const std::string content = R"({"pipe": [1, 2, 3]})";
+	REQUIRE(write(fds[1], content.data(), content.size()) == static_cast<ssize_t>(content.size()));
+	close(fds[1]);
+
+	JsonFile file("/dev/fd/" + std::to_string(fds[0]));
+	CHECK(file.isMapped() == false);
+	CHECK(file.getView() == content);
+	close(fds[0]);
+}
+#endif
+
 // Custom type for testing
 struct Person
 {
@@ -855,6 +1301,241 @@ TEST_CASE("FROM_TO_JSON_CAST macro")
 	CHECK(converted == original);
 }
 
+// Field maps: read straight from the text by Json::parseInto, converted through Json by FROM_TO_JSON_FIELDS
+struct Point
+{
+	double x = 0;
+	double y = 0;
+};
+
+struct Shape
+{
+	std::string name;
+	int64_t id = 0;
+	bool closed = false;
+	std::vector<Point> points;
+	std::optional<Point> center;
+	std::map<std::string, int> tags;
+	Json extra;
+};
+
+template <> struct JsonFields<Point>
+{
+	static constexpr auto fields = std::make_tuple(jsonField("x", &Point::x), jsonField("y", &Point::y));
+};
+
+template <> struct JsonFields<Shape>
+{
+	static constexpr auto fields = std::make_tuple(jsonField("name", &Shape::name), jsonField("id", &Shape::id),
+		jsonField("closed", &Shape::closed), jsonField("points", &Shape::points), jsonField("center", &Shape::center),
+		jsonField("tags", &Shape::tags), jsonField("extra", &Shape::extra));
+};
+
+FROM_TO_JSON_FIELDS(Point)
+FROM_TO_JSON_FIELDS(Shape)
+
+TEST_CASE("Typed parsing - Fields")
+{
+	std::string text = R"({"name": "tri\"angle", "unknown": {"a": [1, {"b": null}], "c": "x"}, "id": 9007199254740993,
+		"closed": true, "points": [{"x": 1, "y": 2.5}, {"y": -3, "z": [true]}, {}], "center": {"x": 0.5, "y": 0.25},
+		"tags": {"red": 1, "blue": 2}, "extra": {"any": [1, "json"]}, "more": []})";
+
+	Shape shape = Json::parseAs<Shape>(text);
+	CHECK(shape.name == "tri\\\"angle"); // as written in json, like the strings of a Json
+	CHECK(shape.id == 9007199254740993);
+	CHECK(shape.closed);
+	REQUIRE(shape.points.size() == 3);
+	CHECK(shape.points[0].x == 1);
+	CHECK(shape.points[0].y == 2.5);
+	CHECK(shape.points[1].x == 0); // missing keys keep the value of their member
+	CHECK(shape.points[1].y == -3);
+	REQUIRE(shape.center.has_value());
+	CHECK(shape.center->x == 0.5);
+	CHECK(shape.tags == std::map<std::string, int>{{"red", 1}, {"blue", 2}});
+	CHECK(static_cast<const std::string&>(shape.extra["any"][1]) == "json");
+
+	// same result as parsing a Json and converting it
+	Shape converted = Json::parse(text);
+	CHECK(converted.name == shape.name);
+	CHECK(converted.id == shape.id);
+	CHECK(converted.points.size() == 3);
+	CHECK(converted.points[1].y == shape.points[1].y);
+	CHECK(converted.tags == shape.tags);
+	CHECK(Json(converted).toString() == Json(shape).toString());
+
+	// an empty optional is null in the text, left out by toJson
+	Json::parseInto(R"({"center": null, "points": []})", shape);
+	CHECK(!shape.center.has_value());
+	CHECK(shape.points.empty());
+	CHECK(shape.name == "tri\\\"angle");
+	CHECK(!Json(shape).hasKey("center"));
+
+	Point point;
+	JsonError error;
+	CHECK(Json::tryParseInto(" {\"x\": 4} ", point, error));
+	CHECK(!error);
+	CHECK(point.x == 4);
+}
+
+TEST_CASE("Typed parsing - Other types")
+{
+	CHECK(Json::parseAs<std::vector<int>>("[1, 2, 3]") == std::vector<int>{1, 2, 3});
+	CHECK(Json::parseAs<std::vector<bool>>("[true, false]") == std::vector<bool>{true, false});
+	CHECK(Json::parseAs<std::vector<std::vector<double>>>("[[], [1.5]]") == std::vector<std::vector<double>>{{}, {1.5}});
+	CHECK(Json::parseAs<std::map<std::string, std::string>>(R"({"a": "b"})") == std::map<std::string, std::string>{{"a", "b"}});
+	CHECK(Json::parseAs<std::optional<int>>("null") == std::nullopt);
+	CHECK(Json::parseAs<std::optional<int>>("7") == 7);
+	CHECK(Json::parseAs<size_t>("18446744073709551615") == SIZE_MAX);
+	CHECK(Json::parseAs<char>("65") == 'A');
+	CHECK(static_cast<int>(Json::parseAs<Json>(R"({"a": [1]})")["a"][0]) == 1);
+
+	// types without a field map go through fromJson
+	Person person = Json::parseAs<Person>(R"({"name": "Bob", "age": 30, "isStudent": false, "scoreList": [1.5]})");
+	CHECK(person.name == "Bob");
+	CHECK(person.scoreList == std::vector<double>{1.5});
+	std::vector<Person> persons =
+		Json::parseAs<std::vector<Person>>(R"([{"name": "C", "age": 1, "isStudent": true, "scoreList": []}])");
+	REQUIRE(persons.size() == 1);
+	CHECK(persons[0].isStudent);
+}
+
+TEST_CASE("Typed parsing - Errors")
+{
+	Shape shape;
+	JsonError error;
+
+	// valid json of another type
+	CHECK(!Json::tryParseInto(R"({"id": "9"})", shape, error));
+	CHECK(error.code == JsonErrorCode::UnexpectedType);
+	CHECK(error.offset == 7);
+	CHECK(error.toString() == "Unexpected type at position 7");
+	CHECK(!Json::tryParseInto(R"({"points": [{"x": true}]})", shape, error));
+	CHECK(error.code == JsonErrorCode::UnexpectedType);
+	CHECK(!Json::tryParseInto("[1]", shape, error));
+	CHECK(error.code == JsonErrorCode::UnexpectedType);
+	CHECK(error.offset == 0);
+
+	// invalid json gives the error of Json::tryParse, in skipped values too
+	for (std::string text : {R"({"id": x})", R"({"unknown": [1,]})", R"({"points": [{"x": 1},]})", R"({"name": "a" "id": 1})",
+			 R"({"tags": {"a": 1)", R"({"center": nul})", R"({"name": "\q"})", "{} {}", "", R"({"points": [)"})
+	{
+		JsonError expected;
+		Json json;
+		CHECK(!Json::tryParse(text, json, expected));
+		CHECK(!Json::tryParseInto(text, shape, error));
+		CHECK(error.code == expected.code);
+		CHECK(error.offset == expected.offset);
+		CHECK(error.expected == expected.expected);
+	}
+
+	// depth limit
+	JsonParseOptions options;
+	options.maxDepth = 4;
+	CHECK(Json::tryParseInto(R"({"points": [{"x": 1}]})", shape, error, options));
+	CHECK(!Json::tryParseInto(R"({"points": [{"x": [1]}]})", shape, error, options));
+	CHECK(error.code == JsonErrorCode::MaxDepthExceeded);
+	CHECK(error.maxDepth == 4);
+	CHECK(Json::tryParseInto(R"({"unknown": [[1]]})", shape, error, options));
+	CHECK(!Json::tryParseInto(R"({"unknown": [[[1]]]})", shape, error, options));
+	CHECK(error.code == JsonErrorCode::MaxDepthExceeded);
+
+	CHECK_THROWS_AS(Json::parseAs<int>("\"1\""), JsonParseError);
+}
+
+struct Keys
+{
+	int a = 0, ab = 0, ba = 0, abc = 0, empty = 0, upper = 0, longer = 0, f1 = 0, f2 = 0, f10 = 0, f11 = 0, f12 = 0;
+};
+
+template <> struct JsonFields<Keys>
+{
+	static constexpr auto fields = std::make_tuple(jsonField("a", &Keys::a), jsonField("ab", &Keys::ab),
+		jsonField("ba", &Keys::ba), jsonField("abc", &Keys::abc), jsonField("", &Keys::empty), jsonField("A", &Keys::upper),
+		jsonField("a key longer than the others", &Keys::longer), jsonField("f1", &Keys::f1), jsonField("f2", &Keys::f2),
+		jsonField("f10", &Keys::f10), jsonField("f11", &Keys::f11), jsonField("f12", &Keys::f12));
+};
+
+FROM_TO_JSON_FIELDS(Keys)
+
+TEST_CASE("Typed parsing - Keys are dispatched by a perfect hash")
+{
+	using Table = detail::FieldHashTable<Keys>;
+	static_assert(Table::count == 12);
+	for (size_t i = 0; i < Table::count; ++i) CHECK(Table::find(Table::keys[i]) == i);
+	for (std::string_view key : {"b", "abcd", "f", "f3", "f100", "a key longer than the other", "AB", " a"})
+		CHECK(Table::find(key) == Table::count);
+
+	std::string text = R"({"f12": 12, "a": 1, "ab": 2, "ba": 3, "abc": 4, "": 5, "A": 6, "a key longer than the others": 7,
+		"f1": 8, "f2": 9, "f10": 10, "f11": 11, "f3": -1, "abcd": -1, "b": -1})";
+	Keys parsed = Json::parseAs<Keys>(text);
+	Keys converted = Json::parse(text);
+	for (const Keys& keys : {parsed, converted})
+	{
+		CHECK(keys.a == 1);
+		CHECK(keys.ab == 2);
+		CHECK(keys.ba == 3);
+		CHECK(keys.abc == 4);
+		CHECK(keys.empty == 5);
+		CHECK(keys.upper == 6);
+		CHECK(keys.longer == 7);
+		CHECK(keys.f1 == 8);
+		CHECK(keys.f2 == 9);
+		CHECK(keys.f10 == 10);
+		CHECK(keys.f11 == 11);
+		CHECK(keys.f12 == 12);
+	}
+
+	// the conversion keeps the type checks of Json::get
+	CHECK_THROWS_WITH(Keys(Json::parse(R"({"ab": "2"})")), "Expected Number but got String for key 'ab'");
+	CHECK_THROWS_WITH(Keys(Json::parse("[]")), "Expected Object but got Array");
+}
+
+TEST_CASE("Typed writing - Same text as toJson")
+{
+	Shape shape = Json::parseAs<Shape>(R"({"name": "a\\nb", "id": -12, "closed": true, "points": [{"x": 1, "y": 0.1},
+		{"x": -2.5e-300, "y": 1e300}], "center": null, "tags": {"b": 2, "a": 1}, "extra": {"z": [null, {}, []], "a": true}})");
+	Shape empty;
+	std::vector<Shape> shapes = {shape, empty};
+	std::map<int, std::optional<Point>> points = {{3, Point{1, 2}}, {-1, std::nullopt}};
+
+	for (auto [tab, newLine] : {std::pair<std::string, std::string>{"", ""}, {"\t", "\n"}, {"  ", "\r\n"}})
+	{
+		CAPTURE(tab);
+		CHECK(Json::valueToString(shape, tab, newLine) == Json(shape).toString(tab, newLine));
+		CHECK(Json::valueToString(empty, tab, newLine) == Json(empty).toString(tab, newLine));
+		CHECK(Json::valueToString(shapes, tab, newLine) == Json(shapes).toString(tab, newLine));
+		CHECK(Json::valueToString(shape.tags, tab, newLine) == Json(shape.tags).toString(tab, newLine));
+		CHECK(Json::valueToString(std::vector<int>{}, tab, newLine) == "[]");
+	}
+	CHECK(Json::valueToString(points) == R"({"-1": null, "3": {"x": 1, "y": 2}})");
+
+	shape.center = Point{0.5, 3};
+	CHECK(Json::valueToString(shape) == Json(shape).toString());
+	Shape parsed = Json::parseAs<Shape>(Json::valueToString(shape));
+	CHECK(parsed.name == shape.name);
+	CHECK(parsed.center->y == 3);
+	CHECK(parsed.points[1].y == 1e300);
+
+	// control characters are escaped like by Json::operator=
+	shape.name = "a\tb\nc\r";
+	CHECK(Json::valueToString(shape) == Json(shape).toString());
+	CHECK(Json::parseAs<Shape>(Json::valueToString(shape)).name == R"(a\tb\nc\r)");
+	std::vector<std::string> lines = {"x\ny", "\t", "plain"};
+	CHECK(Json::valueToString(lines) == Json(lines).toString());
+	CHECK(Json::valueToString(lines) == R"(["x\ny", "\t", "plain"])");
+
+	// other types go through toJson
+	Person person{"Alice", 20, true, {95.5}};
+	CHECK(Json::valueToString(std::vector<Person>{person}) == Json(std::vector<Person>{person}).toString());
+
+	std::ostringstream stream;
+	{
+		JsonStreamSink sink(stream);
+		Json::writeValue(sink, std::vector<bool>{true, false});
+	}
+	CHECK(stream.str() == "[true, false]");
+}
+
 TEST_CASE("Nested object access")
 {
 	Json json;
@@ -955,6 +1636,53 @@ TEST_CASE("Parse zero")
 	CHECK(static_cast<double>(json2) == 0.0);
 }
 
+TEST_CASE("Numbers - 64-bit integers are exact")
+{
+	Json id = Json::parse("1234567890123456789");
+	CHECK(id.isInteger());
+	CHECK(static_cast<int64_t>(id) == 1234567890123456789LL);
+	CHECK(id.toString() == "1234567890123456789");
+
+	Json big = Json::parse("18446744073709551615");
+	CHECK(big.isInteger());
+	CHECK(static_cast<size_t>(big) == UINT64_MAX);
+	CHECK(big.toString() == "18446744073709551615");
+
+	Json min = Json::parse("-9223372036854775808");
+	CHECK(static_cast<int64_t>(min) == INT64_MIN);
+	CHECK(min.toString() == "-9223372036854775808");
+
+	// too large for 64 bits, with a fraction or an exponent: a double
+	const char* doubleList[] = {"18446744073709551616", "-9223372036854775809", "1.0", "1e3", "-0"};
+	for (const char* text : doubleList)
+	{
+		CAPTURE(std::string(text));
+		CHECK(Json::parse(text).isInteger() == false);
+	}
+	CHECK(std::signbit(static_cast<double>(Json::parse("-0"))));
+	CHECK(static_cast<double>(Json::parse("18446744073709551616")) == 18446744073709551616.0);
+
+	// assignments and copies keep the integer
+	Json json = int64_t(4611686018427387905LL);
+	CHECK(json.isInteger());
+	Json copy = json;
+	CHECK(static_cast<int64_t>(copy) == 4611686018427387905LL);
+	Json arr = Json::parse(R"([9007199254740993, 1.5])");
+	arr.emplace_back(arr[0]);
+	CHECK(static_cast<int64_t>(arr[2]) == 9007199254740993LL);
+	CHECK(arr.toString() == "[9007199254740993, 1.5, 9007199254740993]");
+	json = size_t(UINT64_MAX);
+	CHECK(static_cast<size_t>(json) == UINT64_MAX);
+	CHECK(static_cast<int>(Json(42)) == 42);
+	CHECK(static_cast<double>(Json(int64_t(-7))) == -7.0);
+
+	// a double reference turns the value into a double
+	json = 12;
+	double& d = json;
+	CHECK(d == 12.0);
+	CHECK(json.isInteger() == false);
+}
+
 TEST_CASE("Round trip - Parse and toString")
 {
 	std::string original = R"({"name": "test", "values": [1, 2, 3]})";
@@ -1164,3 +1892,899 @@ TEST_CASE("ToJson - Edge cases")
 	Json jsonNegative = negative;
 	CHECK(static_cast<int>(jsonNegative) == -42);
 }
+
+TEST_CASE("Scanner - Block scanners match the scalar scan")
+{
+	const auto& scanner = detail::getScanner();
+	// put each special character at every offset of buffers crossing the 16 and 32 byte blocks
+	for (char special : {'"', '\\', '\n', '\t', '\r'})
+	{
+		for (size_t size = 0; size < 80; ++size)
+		{
+			for (size_t at = 0; at <= size; ++at)
+			{
+				std::string buffer(size, 'a');
+				if (at < size) buffer[at] = special;
+				for (size_t start : {size_t(0), size_t(1), size_t(7)})
+				{
+					if (start > size) continue;
+					CHECK(scanner.scanString(buffer.data(), start, size)
+						  == detail::scanStringScalar(buffer.data(), start, size));
+				}
+			}
+		}
+	}
+	for (size_t size = 0; size < 80; ++size)
+	{
+		for (size_t at = 0; at <= size; ++at)
+		{
+			std::string buffer(size, ' ');
+			for (size_t i = 0; i < size; ++i) buffer[i] = " \t\n\r\v\f"[i % 6];
+			if (at < size) buffer[at] = (at % 2) ? 'x' : '\x80';
+			CHECK(scanner.skipSpace(buffer.data(), 0, size) == detail::skipSpaceScalar(buffer.data(), 0, size));
+		}
+	}
+}
+
+TEST_CASE("Parsing - Long strings and indentation")
+{
+	std::string longText(100, 'x');
+	std::string input = "{\n" + std::string(40, ' ') + "\"key\":" + std::string(40, '\t') + "\"" + longText + "\\\"" + longText
+						+ "\"" + std::string(33, '\n') + "}";
+	Json json = Json::parse(input);
+	CHECK(static_cast<const std::string&>(json["key"]) == longText + "\\\"" + longText);
+
+	Json error;
+	CHECK(Json::tryParse("\"" + longText + "\t" + longText + "\"", error) == false);
+	CHECK(Json::tryParse("\"" + longText, error) == false);
+	CHECK(Json::tryParse("\"" + longText + "\\", error) == false);
+}
+
+TEST_CASE("Arena - Parse into an arena")
+{
+	const std::string input
+		= R"({"users": [{"name": "John", "scores": [90, 85]}, {"name": "Jane", "scores": [95, 88]}], "empty": {}})";
+	JsonArena arena(256);
+	Json json = Json::parse(input, arena);
+	CHECK(json.toString() == Json::parse(input).toString());
+	CHECK(arena.getChunkCount() > 0);
+	CHECK(arena.getUsedSize() > 0);
+	CHECK(static_cast<const JsonArr&>(json["users"]).get_allocator().arena == &arena);
+
+	Json error;
+	CHECK(Json::tryParse("[1, 2", error, arena) == false);
+	CHECK(Json::tryParse("[1, 2]", error, arena) == true);
+	CHECK(error.size() == 2);
+}
+
+TEST_CASE("Arena - Big allocations and release")
+{
+	JsonArena arena(1024);
+	std::string input = "[";
+	for (int i = 0; i < 1000; ++i) input += std::to_string(i) + ",";
+	input.back() = ']';
+	{
+		Json json = Json::parse(input, arena);
+		CHECK(json.size() == 1000);
+		CHECK(static_cast<int>(json[999]) == 999);
+		CHECK(arena.getChunkCount() > 1);
+	}
+	arena.release();
+	CHECK(arena.getChunkCount() == 0);
+	CHECK(arena.getUsedSize() == 0);
+}
+
+TEST_CASE("Arena - Document")
+{
+	JsonDocument doc(R"({"name": "Alice", "hobbies": ["reading", "coding"]})");
+	CHECK(static_cast<const std::string&>(doc.getRoot()["name"]) == "Alice");
+	CHECK(doc.getArena().getChunkCount() == 1);
+
+	// copies leave the arena, so they outlive the document content
+	Json hobbies = doc.getRoot()["hobbies"];
+	CHECK(static_cast<const JsonArr&>(hobbies).get_allocator().arena == nullptr);
+
+	std::string error;
+	CHECK(doc.tryParse("[1, 2, 3]", error) == true);
+	CHECK(doc.getRoot().size() == 3);
+	CHECK(doc.tryParse("{", error) == false);
+	CHECK(!error.empty());
+	doc.release();
+	CHECK(doc.getRoot().getType() == Json::Type::Null);
+	CHECK(doc.getArena().getChunkCount() == 0);
+	CHECK(hobbies.toString() == R"(["reading", "coding"])");
+}
+
+static size_t getLivePayloadCount()
+{
+	return Json::getAllocationCount(Json::Type::String).getLiveCount()
+		   + Json::getAllocationCount(Json::Type::Array).getLiveCount()
+		   + Json::getAllocationCount(Json::Type::Object).getLiveCount();
+}
+
+TEST_CASE("Lifetime - Reassignments do not leak")
+{
+	size_t liveBefore = getLivePayloadCount();
+	{
+		Json json = Json::parse(R"({"users": [{"name": "John", "scores": [90, 85]}, {"name": "Jane"}]})");
+		json["users"][0] = "replaced";
+		json["users"] = 42;
+		json = JsonArr{Json("a"), Json(JsonObj{{"b", Json("c")}})};
+		json = json[1];		   // assign a child to its parent
+		json = std::move(json["b"]); // move a child into its parent
+		CHECK(static_cast<const std::string&>(json) == "c");
+		json = Json::Type::Object;
+		json["x"] = std::vector<int>{1, 2, 3};
+		json = std::map<std::string, std::string>{{"k", "v"}};
+		Json copy = json;
+		copy = nullptr;
+		json = true;
+		CHECK(getLivePayloadCount() == liveBefore);
+		json = "text";
+	}
+	CHECK(getLivePayloadCount() == liveBefore);
+}
+
+TEST_CASE("Lifetime - Same type assignments reuse the payload")
+{
+	Json json = "first value";
+	auto allocatedBefore = Json::getAllocationCount(Json::Type::String).allocated;
+	json = "second value";
+	json = std::string("third value");
+	json = Json("fourth value");
+	CHECK(static_cast<const std::string&>(json) == "fourth value");
+	// only the temporary of the last line constructed a new string
+	CHECK(Json::getAllocationCount(Json::Type::String).allocated == allocatedBefore + 1);
+}
+
+TEST_CASE("Lifetime - Arena document release")
+{
+	size_t liveBefore = getLivePayloadCount();
+	{
+		JsonDocument doc(R"([{"a": "a string longer than the small buffer"}, [1, 2], "x"])");
+		CHECK(getLivePayloadCount() > liveBefore);
+		doc.parse("[]");
+	}
+	CHECK(getLivePayloadCount() == liveBefore);
+}
+
+TEST_CASE("Lifetime - Compact values")
+{
+	// scalars are inline, strings and containers sit behind one pointer
+	CHECK(sizeof(Json) == 16);
+
+	Json json = Json::parse(R"({"list": [1, 2, 3], "name": "a string longer than the small buffer"})");
+	const JsonArr* list = &static_cast<const JsonArr&>(json["list"]);
+	size_t allocatedBefore = Json::getAllocationCount(Json::Type::Array).allocated;
+	Json moved = std::move(json);
+	Json movedAgain(std::move(moved));
+	// moves hand the payload over without allocating
+	CHECK(&static_cast<const JsonArr&>(movedAgain["list"]) == list);
+	CHECK(Json::getAllocationCount(Json::Type::Array).allocated == allocatedBefore);
+	CHECK(static_cast<std::string_view>(movedAgain["name"]) == "a string longer than the small buffer");
+	CHECK(static_cast<int64_t>(movedAgain["list"][2]) == 3);
+
+	// the lookup hint lives in the object payload, so const lookups still work on copies
+	const Json copy = movedAgain;
+	CHECK(copy.hasKey("name"));
+	CHECK(static_cast<int64_t>(copy["list"][0]) == 1);
+	CHECK(copy.toString() == movedAgain.toString());
+
+	// parsed payloads go to the arena, copies go back to the heap
+	JsonArena arena;
+	Json parsed = Json::parse(R"(["a string longer than the small buffer", {"k": [true]}])", arena);
+	size_t usedSize = arena.getUsedSize();
+	CHECK(usedSize >= 3 * sizeof(Json) + sizeof(std::string));
+	Json outside = parsed;
+	CHECK(arena.getUsedSize() == usedSize);
+	parsed = nullptr;
+	CHECK(outside.toString() == R"(["a string longer than the small buffer", {"k": [true]}])");
+}
+
+TEST_CASE("Lifetime - Short strings are stored inline")
+{
+	size_t liveBefore = getLivePayloadCount();
+	auto stringsBefore = Json::getAllocationCount(Json::Type::String).allocated;
+	const std::string input = R"({"id": "a1b2", "tags": ["red", "green", ""], "text": "a string longer than the small buffer"})";
+	{
+		Json json = Json::parse(input);
+		// only the long string has a payload
+		CHECK(Json::getAllocationCount(Json::Type::String).allocated == stringsBefore + 1);
+		auto id = static_cast<std::string_view>(json["id"]);
+		CHECK(id == "a1b2");
+		CHECK(static_cast<const void*>(id.data()) >= static_cast<const void*>(&json["id"]));
+		CHECK(static_cast<const void*>(id.data()) < static_cast<const void*>(&json["id"] + 1));
+		CHECK(json.toString() == input);
+
+		// a const std::string& refers to the payload of a long string, reading it does not allocate
+		const Json& constJson = json;
+		size_t heapBefore = heapAllocationCount;
+		for (int i = 0; i < 100; ++i)
+		{
+			const std::string& text = constJson["text"];
+			CHECK(text.size() == 37);
+		}
+		CHECK(heapAllocationCount == heapBefore);
+		CHECK(&static_cast<const std::string&>(constJson["text"]) == &static_cast<const std::string&>(constJson["text"]));
+
+		// an inline string makes one copy in the node on the first read, it stays valid while the value lives,
+		// even when it is moved
+		const std::string& red = constJson["tags"][0];
+		CHECK(Json::getAllocationCount(Json::Type::String).allocated == stringsBefore + 2);
+		CHECK(&static_cast<const std::string&>(constJson["tags"][0]) == &red);
+		const char* green = constJson["tags"][1];
+		CHECK(std::string(green) == "green");
+		CHECK(static_cast<const char*>(constJson["tags"][1]) == green);
+		Json tags = std::move(json["tags"]);
+		CHECK(&static_cast<const std::string&>(std::as_const(tags)[0]) == &red);
+		CHECK(red == "red");
+
+		// a mutable access takes ownership of the text
+		std::string& owned = tags[2];
+		owned = "now a longer string";
+		CHECK(static_cast<std::string_view>(tags[2]) == "now a longer string");
+		tags[1] = "blue";
+		Json copy = tags;
+		CHECK(copy.toString() == R"(["red", "blue", "now a longer string"])");
+	}
+	CHECK(getLivePayloadCount() == liveBefore);
+}
+
+TEST_CASE("Lifetime - Rvalues are moved in")
+{
+	auto countAllocations = [](auto&& build) {
+		size_t before = heapAllocationCount;
+		build();
+		return heapAllocationCount - before;
+	};
+	const std::string big(1000, 'x');
+
+	// a moved string keeps its buffer, only its payload is allocated
+	std::string text = big;
+	const char* data = text.data();
+	Json json;
+	CHECK(countAllocations([&] { json = std::move(text); }) == 1);
+	CHECK(static_cast<const std::string&>(json).data() == data);
+	CHECK(static_cast<const std::string&>(json) == big);
+	std::string copied = big;
+	CHECK(countAllocations([&] { Json other(copied); }) == 2);
+	CHECK(copied == big);
+
+	// containers move their elements
+	std::vector<std::string> list(100, big);
+	std::map<std::string, std::string> map{{"a", big}, {"b", big}};
+	size_t copyCount = countAllocations([&] {
+		Json doc;
+		doc["list"] = list;
+		doc.set("map", map);
+	});
+	size_t moveCount = countAllocations([&] {
+		Json doc;
+		doc["list"] = std::move(list);
+		doc.set("map", std::move(map));
+		CHECK(doc["list"].size() == 100);
+		CHECK(static_cast<const std::string&>(doc["map"]["b"]) == big);
+	});
+	CHECK(copyCount - moveCount == 102);
+
+	std::vector<std::string> strings{big, big};
+	Json arr;
+	CHECK(countAllocations([&] {
+		arr.emplace_back(std::move(strings[0]));
+		arr.emplace_back(std::move(strings[1]));
+	}) == 5); // the array payload, its two buffers and one payload per string
+
+	JsonArr elements(10);
+	const Json* first = elements.data();
+	Json moved = std::move(elements);
+	CHECK(&static_cast<const JsonArr&>(moved)[0] == first);
+}
+
+TEST_CASE("Objects - Hash index on big objects")
+{
+	const int keyCount = 100000;
+	std::string input = "{";
+	for (int i = 0; i < keyCount; ++i) input += "\"key" + std::to_string(i) + "\": " + std::to_string(i) + ",";
+	input += "\"key0\": -1}"; // duplicated key overwrites the first value
+	Json json = Json::parse(input);
+	CHECK(json.size() == keyCount);
+	CHECK(static_cast<int>(json["key0"]) == -1);
+	CHECK(static_cast<int>(json["key99999"]) == 99999);
+	CHECK(json.hasKey("key12345"));
+	CHECK(!json.hasKey("key100000"));
+
+	const Json copy = json;
+	int value = 0;
+	CHECK(copy.tryGet("key54321", value));
+	CHECK(value == 54321);
+	CHECK(!copy.hasKey("missing"));
+
+#ifndef SORT_JSON_OBJECT_KEYS
+	// keys changed through the JsonObj reference are seen by the next lookups
+	JsonObj& obj = json;
+	obj.back().first = "renamed";
+	CHECK(json.hasKey("renamed"));
+	CHECK(!json.hasKey("key99999"));
+	json["added"] = 1;
+	CHECK(json.size() == keyCount + 1);
+	CHECK(static_cast<int>(json["added"]) == 1);
+	CHECK(static_cast<int>(json["renamed"]) == 99999);
+#endif
+}
+
+TEST_CASE("Objects - Insertion order is kept with the index")
+{
+	Json json;
+	for (int i = 0; i < 40; ++i) json[std::to_string(39 - i)] = i;
+#ifndef SORT_JSON_OBJECT_KEYS
+	const JsonObj& obj = json;
+	int i = 0;
+	for (const auto& [key, value] : obj)
+	{
+		CHECK(static_cast<int>(value) == i);
+		++i;
+	}
+#endif
+	CHECK(static_cast<int>(json["0"]) == 39);
+}
+
+TEST_CASE("Objects - Key pool")
+{
+	JsonKeyPool pool;
+	JsonParseOptions options;
+	options.keyPool = &pool;
+	const std::string input = R"({"id": 1, "a key longer than the small buffer": {"id": 2, "name": "x"}})";
+	Json first = Json::parse(input, options);
+	Json second = Json::parse(input, options);
+	CHECK(pool.size() == 3);
+	CHECK(first.toString() == Json::parse(input).toString());
+
+	// every document points to the same pooled text
+	const JsonObj& firstObj = first;
+	const JsonObj& secondObj = second;
+	CHECK(firstObj.begin()->first.isPooled());
+	CHECK(&firstObj.begin()->first.str() == &secondObj.begin()->first.str());
+	Json plain = Json::parse(input);
+	const JsonObj& plainObj = plain;
+	CHECK(!plainObj.begin()->first.isPooled());
+
+	// lookups with a handle, or with any string
+	JsonKey id = pool.intern("id");
+	CHECK(pool.size() == 3);
+	CHECK(static_cast<int>(std::as_const(first)[id]) == 1);
+	CHECK(static_cast<int>(second["a key longer than the small buffer"][id]) == 2);
+	CHECK(first.hasKey(id));
+	CHECK(first.hasKey(std::string("id")));
+	CHECK(!first.hasKey(pool.intern("missing")));
+	CHECK(static_cast<int>(plain[id]) == 1);
+	first[pool.intern("added")] = 3;
+	CHECK(static_cast<int>(first["added"]) == 3);
+
+	// keys read like strings
+	CHECK(id == "id");
+	CHECK(std::string("id") == id);
+	CHECK(id != std::string_view("name"));
+	CHECK(id < JsonKey("name"));
+	std::string text = id;
+	CHECK(text == "id");
+	std::ostringstream os;
+	os << id;
+	CHECK(os.str() == "id");
+	CHECK(id.length() == 2);
+	CHECK("k_" + id == "k_id");
+	CHECK(id + std::string("_k") + JsonKey("!") == "id_k!");
+
+	// keys become string values, pooled or not
+	Json keyList;
+	std::vector<std::string> expectedKeyList;
+	for (const auto& [key, value] : firstObj)
+	{
+		keyList.emplace_back(key);
+		expectedKeyList.push_back(key.str());
+	}
+	CHECK(static_cast<std::vector<std::string>>(keyList) == expectedKeyList);
+	Json fromKey = id;
+	CHECK(static_cast<std::string_view>(fromKey) == "id");
+	fromKey = JsonKey("a key outside of any pool");
+	CHECK(static_cast<std::string_view>(fromKey) == "a key outside of any pool");
+
+	// concurrent parses share the pool
+	std::vector<std::thread> threads;
+	std::atomic<int> mismatches{0};
+	for (int t = 0; t < 4; ++t)
+		threads.emplace_back(
+			[&pool, &mismatches, t]()
+			{
+				JsonParseOptions threadOptions;
+				threadOptions.keyPool = &pool;
+				for (int i = 0; i < 200; ++i)
+				{
+					Json json = Json::parse("{\"k" + std::to_string(i) + "\": " + std::to_string(t) + "}", threadOptions);
+					if (static_cast<int>(json["k" + std::to_string(i)]) != t) ++mismatches;
+				}
+			});
+	for (auto& thread : threads) thread.join();
+	CHECK(mismatches == 0);
+	CHECK(pool.size() == 5 + 200);
+}
+
+TEST_CASE("Objects - Concurrent const readers")
+{
+	// a small object (lookup hint), a big one (hash index), inline and borrowed strings
+	std::string text = "{\"small\": {\"a\": 1, \"b\": \"two\", \"c\": [1, 2, 3]}, \"big\": {";
+	for (int i = 0; i < 40; ++i) text += (i ? ", \"k" : "\"k") + std::to_string(i) + "\": " + std::to_string(i);
+	text += "}, \"name\": \"a longer string value\", \"list\": [\"x\", {\"y\": null}]}";
+	JsonParseOptions options;
+	options.borrowStrings = true;
+	const Json config = Json::parse(text, options);
+	const Json inlineConfig = Json::parse(text); // short strings inline, copied on the first std::string& read
+	const std::string expectedText = config.toString("\t", "\n");
+
+	std::atomic<size_t> mismatchCount{0};
+	std::vector<std::thread> threads;
+	for (int t = 0; t < 8; ++t)
+	{
+		threads.emplace_back(
+			[&, t]
+			{
+				for (int i = 0; i < 200; ++i)
+				{
+					const Json& small = config["small"];
+					const char* keys[] = {"a", "b", "c"};
+					bool ok = small.hasKey(keys[(i + t) % 3]) && !small.hasKey("d");
+					ok = ok && static_cast<int>(small["a"]) == 1;
+					ok = ok && static_cast<const std::string&>(small["b"]) == "two";
+					ok = ok && static_cast<int>(config["big"]["k" + std::to_string((i * 7 + t) % 40)]) == (i * 7 + t) % 40;
+					ok = ok && static_cast<const std::string&>(config["name"]) == "a longer string value";
+					ok = ok && static_cast<const std::string&>(config["list"][0]) == "x";
+					ok = ok && static_cast<const std::string&>(inlineConfig["small"]["b"]) == "two";
+					ok = ok && std::string_view(static_cast<const char*>(inlineConfig["list"][0])) == "x";
+					int value = 0;
+					ok = ok && config["big"].tryGet("k39", value) && value == 39;
+					if (i % 20 == 0) ok = ok && config.toString("\t", "\n") == expectedText;
+					if (!ok) ++mismatchCount;
+				}
+			});
+	}
+	for (auto& thread : threads) thread.join();
+	CHECK(mismatchCount == 0);
+}
+
+TEST_CASE("Borrowed strings - Parse without copying the strings")
+{
+	const std::string input = R"({"name": "a string longer than the small buffer", "list": ["x", "y\"z"]})";
+	JsonParseOptions options;
+	options.borrowStrings = true;
+	auto stringsBefore = Json::getAllocationCount(Json::Type::String).allocated;
+	Json json = Json::parse(input, options);
+	CHECK(Json::getAllocationCount(Json::Type::String).allocated == stringsBefore);
+
+	CHECK(json["name"].isBorrowedString());
+	auto name = static_cast<std::string_view>(json["name"]);
+	CHECK(name == "a string longer than the small buffer");
+	CHECK(name.data() >= input.data());
+	CHECK(name.data() < input.data() + input.size());
+	CHECK(static_cast<std::string_view>(json["list"][1]) == "y\\\"z");
+	CHECK(json.toString() == Json::parse(input).toString());
+
+	// conversions by value copy the text
+	const Json& constJson = json;
+	std::string value = constJson["name"];
+	CHECK(json["name"].isBorrowedString());
+	CHECK(value == name);
+	std::string x;
+	CHECK(json["list"][0].getType() == Json::Type::String);
+	Json list = json["list"];
+	CHECK(!list[0].isBorrowedString()); // copies own their strings
+	CHECK(json.tryGet("name", x));
+	CHECK(x == name);
+	// std::string references are served by a single copy made on the first read
+	const std::string& reference = constJson["name"];
+	CHECK(reference == name);
+	CHECK(&static_cast<const std::string&>(constJson["name"]) == &reference);
+	CHECK(static_cast<const char*>(constJson["name"]) == reference.c_str());
+	CHECK(constJson["name"].isBorrowedString());
+
+	// a mutable access (including non const std::string conversions) takes ownership
+	std::string& owned = json["name"];
+	owned += "!";
+	CHECK(!json["name"].isBorrowedString());
+	CHECK(static_cast<std::string_view>(json["name"]) == "a string longer than the small buffer!");
+	CHECK(input.find('!') == std::string::npos);
+}
+
+TEST_CASE("Borrowed strings - Document")
+{
+	const std::string input = R"(["first", "second"])";
+	JsonParseOptions options;
+	options.borrowStrings = true;
+	JsonDocument doc(input, options);
+	CHECK(doc.getRoot()[1].isBorrowedString());
+	CHECK(static_cast<std::string_view>(doc.getRoot()[1]) == "second");
+	doc.getRoot()[0] = "replaced";
+	CHECK(!doc.getRoot()[0].isBorrowedString());
+	CHECK(doc.getRoot().toString() == R"(["replaced", "second"])");
+}
+
+// Handler writing the events in a compact text form
+struct EventRecorder : JsonHandler
+{
+	std::string events;
+
+	void onNull() { events += "null "; }
+	void onBool(bool b) { events += b ? "true " : "false "; }
+	void onNumber(double num) { events += std::to_string(static_cast<int>(num)) + " "; }
+	void onString(const std::string_view& str) { events += "\"" + std::string(str) + "\" "; }
+	void onStartObject() { events += "{ "; }
+	void onKey(const std::string_view& key) { events += std::string(key) + ": "; }
+	void onEndObject() { events += "} "; }
+	void onStartArray() { events += "[ "; }
+	void onEndArray() { events += "] "; }
+};
+
+TEST_CASE("Events - Handler receives the values in order")
+{
+	EventRecorder recorder;
+	Json::parseEvents(R"({"a": [1, true, null], "b": {"c": "d\"e"}, "f": [ ], "g": {}})", recorder);
+	CHECK(recorder.events == R"({ a: [ 1 true null ] b: { c: "d\"e" } f: [ ] g: { } } )");
+}
+
+TEST_CASE("Events - Handler with only some events")
+{
+	// sums the numbers without building any Json
+	struct NumberSum : JsonHandler
+	{
+		double sum = 0;
+		void onNumber(double num) { sum += num; }
+	} numberSum;
+	Json::parseEvents(R"([1, {"x": 2, "y": [3, "4"]}, 5.5])", numberSum);
+	CHECK(numberSum.sum == 11.5);
+
+	std::string error;
+	CHECK(Json::tryParseEvents("[1, 2,]", numberSum, error) == false);
+	CHECK(!error.empty());
+	CHECK(Json::tryParseEvents("[1] 2", numberSum, error) == false);
+	CHECK(Json::tryParseEvents("[]", numberSum, error) == true);
+}
+
+TEST_CASE("Parsing - Empty containers with spaces")
+{
+	CHECK(Json::parse("[ ]").size() == 0);
+	CHECK(Json::parse("{ }").getType() == Json::Type::Object);
+	CHECK(Json::parse(" [ [ ] , { } ] ").toString() == "[[], {}]");
+}
+
+TEST_CASE("Push parser - Same result for every chunk size")
+{
+	const std::string input
+		= R"( {"name": "Alice \"A\" \u00e9", "age": 25, "scores": [1.5, -2e3, 0, 10], "ok": true, "no": false, "none": null,)"
+		  R"( "nested": {"list": [[], {}, [1, [2]]], "empty": ""}} )";
+	const std::string expected = Json::parse(input).toString();
+	JsonPushParser parser;
+	for (size_t chunkSize = 1; chunkSize <= input.size(); ++chunkSize)
+	{
+		for (size_t pos = 0; pos < input.size(); pos += chunkSize) parser.feed(std::string_view(input).substr(pos, chunkSize));
+		CHECK(parser.finish().toString() == expected);
+	}
+}
+
+TEST_CASE("Push parser - Scalars and events")
+{
+	JsonPushParser parser;
+	parser.feed("4");
+	parser.feed("2");
+	CHECK(static_cast<int>(parser.finish()) == 42);
+	parser.feed("\"te");
+	parser.feed("xt\"");
+	CHECK(static_cast<const std::string&>(parser.finish()) == "text");
+	parser.feed("nu");
+	parser.feed("ll ");
+	CHECK(parser.finish().getType() == Json::Type::Null);
+
+	EventRecorder recorder;
+	JsonPushEventParser<EventRecorder> eventParser(recorder);
+	std::string_view first = R"({"a": [1, tr)";
+	std::string_view second = R"(ue, null], "b": {"c": "d"}})";
+	eventParser.feed(first);
+	CHECK(recorder.events == "{ a: [ 1 ");
+	eventParser.feed(second);
+	eventParser.finish();
+	CHECK(recorder.events == R"({ a: [ 1 true null ] b: { c: "d" } } )");
+	CHECK(eventParser.getPosition() == first.size() + second.size());
+}
+
+TEST_CASE("Push parser - Errors")
+{
+	for (const char* input : {"", "[1, 2", "[1, 2,]", "{\"a\" 1}", "{\"a\": 1,}", "[1 2]", "tru", "\"abc", "[1] 2", "-", "1.",
+			 "\"a\tb\"", "\"\\x\"", "\"\\u12g4\"", "nul1", "{1: 2}", "[01]"})
+	{
+		Json json;
+		bool parsed = Json::tryParse(input, json);
+		JsonPushParser parser;
+		bool pushParsed = true;
+		try
+		{
+			parser.feed(input);
+			parser.finish();
+		}
+		catch (const std::runtime_error&)
+		{
+			pushParsed = false;
+		}
+		CHECK_MESSAGE(parsed == pushParsed, input);
+		CHECK_MESSAGE(pushParsed == false, input);
+	}
+
+	// reset after an error forgets the token in progress
+	for (const char* input : {"\"ab\\u12", "\"ab\\", "[tr", "[\"a\", 12"})
+	{
+		JsonPushParser parser;
+		parser.feed(input);
+		CHECK_THROWS_AS(parser.feed("zz\""), JsonParseError);
+		parser.reset();
+		parser.feed("\"xyz\"");
+		CHECK_MESSAGE(static_cast<const std::string&>(parser.finish()) == "xyz", input);
+		parser.feed("\"q\"");
+		CHECK_MESSAGE(static_cast<const std::string&>(parser.finish()) == "q", input);
+	}
+}
+
+TEST_CASE("Parsing - JSON Lines")
+{
+	const std::string text = "{\"id\": 1, \"tags\": [\"a\", \"b\"]}\r\n"
+							 "\n"
+							 "{\"id\": 2,}\n"
+							 "  \t\n"
+							 "[3]\n"
+							 "{\"id\": 4";
+	std::vector<std::string> valueList;
+	std::vector<size_t> lineList;
+	std::vector<JsonError> errorList;
+	size_t errorCount = Json::parseLines(
+		text,
+		[&](Json& value, size_t lineNumber)
+		{
+			valueList.push_back(value.toString());
+			lineList.push_back(lineNumber);
+		},
+		[&](const JsonError& error) { errorList.push_back(error); });
+	CHECK(errorCount == 2);
+	CHECK(valueList == std::vector<std::string>{"{\"id\": 1, \"tags\": [\"a\", \"b\"]}", "[3]"});
+	CHECK(lineList == std::vector<size_t>{1, 5});
+	REQUIRE(errorList.size() == 2);
+	CHECK(errorList[0].code == JsonErrorCode::ExtraComma);
+	CHECK(errorList[0].offset == text.find(",}") + 1);
+	CHECK(errorList[0].line == 3);
+	CHECK(errorList[0].column == 10);
+	CHECK(errorList[1].code == JsonErrorCode::ExpectedCharacter);
+	CHECK(errorList[1].offset == text.size());
+	CHECK(errorList[1].line == 6);
+
+	JsonLineReader reader(text);
+	REQUIRE(reader.next());
+	CHECK(!reader.getError());
+	CHECK(reader.getLineNumber() == 1);
+	CHECK(reader.getLine() == "{\"id\": 1, \"tags\": [\"a\", \"b\"]}");
+	CHECK(static_cast<int>(reader.getValue()["id"]) == 1);
+	Json kept = reader.getValue();
+	REQUIRE(reader.next());
+	CHECK(reader.getError().code == JsonErrorCode::ExtraComma);
+	CHECK(reader.getLineNumber() == 3);
+	CHECK(reader.getValue().getType() == Json::Type::Null);
+	REQUIRE(reader.next());
+	CHECK(reader.getValue().toString() == "[3]");
+	REQUIRE(reader.next());
+	CHECK(reader.getError().line == 6);
+	CHECK(reader.next() == false);
+	CHECK(reader.next() == false);
+	CHECK(kept.toString() == "{\"id\": 1, \"tags\": [\"a\", \"b\"]}");
+
+	// the records reuse the arena
+	std::string lines;
+	for (int i = 0; i < 1000; ++i) lines += "{\"id\": " + std::to_string(i) + ", \"list\": [1, 2, 3, 4, 5, 6, 7, 8]}\n";
+	JsonLineReader bigReader(lines);
+	size_t count = 0;
+	while (bigReader.next()) count += static_cast<size_t>(bigReader.getValue()["list"].size());
+	CHECK(count == 8000);
+	CHECK(bigReader.getArena().getChunkCount() == 1);
+
+	const std::string filename = "test_file.jsonl";
+	{
+		std::ofstream ofs(filename, std::ios::binary);
+		ofs << "{\"name\": \"John\"}\n{\"name\": \"Jane\"}\n";
+	}
+	JsonParseOptions options;
+	options.borrowStrings = true;
+	JsonLineReader fileReader({}, options);
+	fileReader.openFile(filename);
+	REQUIRE(fileReader.next());
+	CHECK(fileReader.getValue()["name"].isBorrowedString());
+	REQUIRE(fileReader.next());
+	CHECK(static_cast<std::string_view>(fileReader.getValue()["name"]) == "Jane");
+	CHECK(fileReader.next() == false);
+	std::string error;
+	CHECK(fileReader.tryOpenFile("missing_file.jsonl", error) == false);
+	CHECK(fileReader.next() == false);
+	(void)std::remove(filename.c_str());
+}
+
+TEST_CASE("Parsing - Parallel JSON Lines")
+{
+	std::string text;
+	for (int i = 0; i < 3000; ++i)
+	{
+		if (i % 100 == 7) text += "{\"id\": " + std::to_string(i) + ",}\n";
+		else if (i % 100 == 8) text += "\n";
+		else
+			text += "{\"id\": " + std::to_string(i) + ", \"list\": [1, 2, 3], \"name\": \"record " + std::to_string(i) + "\"}\n";
+	}
+	text += "[" + std::string(5000, '1') + "]"; // longer than a batch, without a line end
+
+	std::vector<std::pair<size_t, std::string>> expected;
+	std::vector<size_t> expectedErrors;
+	size_t expectedErrorCount = Json::parseLines(
+		text, [&](Json& value, size_t lineNumber) { expected.emplace_back(lineNumber, value.toString()); },
+		[&](const JsonError& error) { expectedErrors.push_back(error.offset); });
+	CHECK(expectedErrorCount == 30);
+	CHECK(expected.size() == 3000 - 60 + 1);
+
+	JsonParallelOptions parallel;
+	parallel.threadCount = 4;
+	parallel.batchSize = 1000;
+	std::vector<std::pair<size_t, std::string>> ordered;
+	std::vector<size_t> orderedErrors;
+	size_t errorCount = Json::parseLines(
+		text, [&](Json& value, size_t lineNumber) { ordered.emplace_back(lineNumber, value.toString()); },
+		[&](const JsonError& error) { orderedErrors.push_back(error.offset); }, parallel);
+	CHECK(errorCount == expectedErrorCount);
+	CHECK(ordered == expected);
+	CHECK(orderedErrors == expectedErrors);
+
+	parallel.ordered = false;
+	std::mutex mutex;
+	std::vector<std::pair<size_t, std::string>> unordered;
+	std::vector<size_t> unorderedErrors;
+	errorCount = Json::parseLines(
+		text,
+		[&](Json& value, size_t lineNumber)
+		{
+			std::string valueText = value.toString();
+			std::lock_guard<std::mutex> lock(mutex);
+			unordered.emplace_back(lineNumber, std::move(valueText));
+		},
+		[&](const JsonError& error)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			unorderedErrors.push_back(error.offset);
+		},
+		parallel);
+	CHECK(errorCount == expectedErrorCount);
+	std::sort(unordered.begin(), unordered.end());
+	std::sort(unorderedErrors.begin(), unorderedErrors.end());
+	CHECK(unordered == expected);
+	CHECK(unorderedErrors == expectedErrors);
+
+	// an exception of a callback stops the parsing and is rethrown
+	for (bool order : {true, false})
+	{
+		parallel.ordered = order;
+		std::atomic<size_t> callCount{0};
+		CHECK_THROWS_AS(Json::parseLines(
+							text,
+							[&](Json&, size_t lineNumber)
+							{
+								++callCount;
+								if (lineNumber == 500) throw std::runtime_error("stop");
+							},
+							[](const JsonError&) {}, parallel),
+			std::runtime_error);
+		CHECK(callCount < expected.size());
+	}
+
+	parallel.ordered = true;
+	CHECK(Json::parseLines("", [](Json&, size_t) { FAIL("no line"); }, [](const JsonError&) {}, parallel) == 0);
+}
+
+TEST_CASE("Parsing - Parallel array")
+{
+	// strings with commas, brackets, escaped quotes and backslashes, cut anywhere by the small batches
+	std::string text = "[\n";
+	for (int i = 0; i < 400; ++i)
+	{
+		if (i != 0) text += ",\n  ";
+		switch (i % 5)
+		{
+		case 0: text += std::to_string(i); break;
+		case 1: text += "\"a, [b] {c} \\\"d, e\\\" \\\\\""; break;
+		case 2: text += "{\"k\": [1, {\"x\": \"]\"}], \"s\": \"\\\\\\\\\"}"; break;
+		case 3: text += "[[], {}, [\"\\\\\", \",\"]]"; break;
+		case 4: text += "null"; break;
+		}
+	}
+	text += "\n]\n";
+	const std::string expected = Json::parse(text).toString();
+
+	for (size_t batchSize : {1, 7, 64, 1000, 1 << 20})
+	{
+		CAPTURE(batchSize);
+		JsonParallelOptions parallel;
+		parallel.threadCount = 3;
+		parallel.batchSize = batchSize;
+		Json json;
+		JsonError error;
+		REQUIRE(Json::tryParse(text, json, error, parallel));
+		CHECK(json.toString() == expected);
+
+		std::vector<std::string> elements;
+		Json::parseElements(text, [&](Json& element, size_t index)
+			{
+				CHECK(index == elements.size());
+				elements.push_back(element.toString());
+			},
+			parallel);
+		REQUIRE(elements.size() == 400);
+		CHECK(elements[2] == json[2].toString());
+
+		parallel.ordered = false;
+		std::atomic<size_t> count{0};
+		Json::parseElements(text, [&](Json&, size_t index) { count += index; }, parallel);
+		CHECK(count == 400 * 399 / 2);
+	}
+
+	JsonParallelOptions parallel;
+	parallel.threadCount = 2;
+	parallel.batchSize = 4;
+	for (const char* input : {"[]", " [ ] ", "[1]", "42", "{\"a\": [1, 2]}", "\"[1, 2]\""})
+	{
+		CAPTURE(std::string(input));
+		CHECK(Json::parse(input, parallel).toString() == Json::parse(input).toString());
+	}
+	CHECK_THROWS_AS(Json::parseElements("{\"a\": [1, 2]}", [](Json&, size_t) {}, parallel), JsonParseError);
+
+	// the errors are the ones of the sequential parser
+	std::string deep = "[1, 2, " + std::string(MAX_JSON_DEPTH, '[') + std::string(MAX_JSON_DEPTH, ']') + "]";
+	for (const std::string& input : std::vector<std::string>{"[1, 2", "[1,]", "[1] x", "[\"a,b\" 2]", "[1, [2, 3], ]", "[",
+			 "[]]", "[1, \"a\\x\", 2]", "[1,\n 2,\n tru]", "[\"abc, 2]", deep, " [null} ", "[\"]}\"}", "[}", "[1, {\"a\": 2}}"})
+	{
+		CAPTURE(input);
+		Json json;
+		JsonError expectedError, error;
+		CHECK(Json::tryParse(input, json, expectedError) == false);
+		CHECK(Json::tryParse(input, json, error, parallel) == false);
+		CHECK(error.code == expectedError.code);
+		CHECK(error.offset == expectedError.offset);
+		CHECK(error.line == expectedError.line);
+		CHECK(error.column == expectedError.column);
+		CHECK_THROWS_AS(Json::parseElements(input, [](Json&, size_t) {}, parallel), JsonParseError);
+	}
+}
+
+TEST_CASE("Numbers - Integers in events")
+{
+	struct IntegerRecorder : JsonHandler
+	{
+		std::vector<int64_t> integerList;
+		std::vector<uint64_t> unsignedList;
+		std::vector<double> doubleList;
+		void onInteger(int64_t i) { integerList.push_back(i); }
+		void onUnsigned(uint64_t u) { unsignedList.push_back(u); }
+		void onNumber(double num) { doubleList.push_back(num); }
+	} recorder;
+	const char* text = "[9007199254740993, -5, 18446744073709551615, 2.5]";
+	Json::parseEvents(text, recorder);
+	CHECK(recorder.integerList == std::vector<int64_t>{9007199254740993LL, -5});
+	CHECK(recorder.unsignedList == std::vector<uint64_t>{UINT64_MAX});
+	CHECK(recorder.doubleList == std::vector<double>{2.5});
+
+	// without onInteger, the integers come as doubles
+	EventRecorder doubleRecorder;
+	Json::parseEvents("[1, -2]", doubleRecorder);
+	CHECK(doubleRecorder.events == "[ 1 -2 ] ");
+
+	// a number split by two chunks
+	JsonPushParser parser;
+	parser.feed("[12345678901");
+	parser.feed("23456789]");
+	Json json = parser.finish();
+	CHECK(static_cast<int64_t>(json[0]) == 1234567890123456789LL);
+}